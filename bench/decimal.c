@@ -0,0 +1,121 @@
+/*
+** Compare the text round-trip and the binary decoding of DECIMAL,
+** MONEY and INT8 cells, INT8 being fetched as BIGINT. No database
+** server is needed.
+**
+** usage: bench_decimal [cells]
+*/
+#include "../ls_informix.c"
+
+#define CELLS	1000000
+#define NVALUES	1024
+
+
+/*
+** Decoders of the text round-trip, as pushvalue did them before.
+*/
+static void old_decimal (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char str_num[64];
+
+	memset(str_num,0,sizeof(str_num));
+	dectoasc((dec_t *)sqlvar->sqldata, str_num, sizeof(str_num)-1, -1);
+	lua_pushnumber(L, atof(str_num));
+}
+
+static void old_int8 (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char str_num[64];
+
+	memset(str_num,0,sizeof(str_num));
+	if (ifx_int8toasc((ifx_int8_t *)sqlvar->sqldata, str_num, sizeof(str_num)-1) == 0)
+		lua_pushinteger(L, atol(str_num));
+	else
+		lua_pushnil(L);
+}
+
+
+/*
+** Decode cells of the values with a decoder, return cells per second.
+*/
+static double run (lua_State *L, col_decoder dec, ifx_sqlvar_t *vars, long cells) {
+	double start = now_seconds();
+	long i;
+
+	for (i = 0; i < cells; i++) {
+		dec(L, NULL, vars + (i % NVALUES));
+		lua_settop(L, 0);
+	}
+	return cells / (now_seconds() - start);
+}
+
+
+/*
+** Check both decoders push the same values.
+*/
+static int check (lua_State *L, col_decoder a, col_decoder b, ifx_sqlvar_t *vars) {
+	int i, bad = 0;
+
+	for (i = 0; i < NVALUES; i++) {
+		a(L, NULL, vars + i);
+		b(L, NULL, vars + i);
+		if (!lua_rawequal(L, -1, -2))
+			bad++;
+		lua_settop(L, 0);
+	}
+	return bad;
+}
+
+
+static void report (const char *name, double before, double after, int bad) {
+	printf("%-16s %12.0f %12.0f %7.2fx %s\n", name, before, after, after / before,
+		bad ? "MISMATCH" : "");
+}
+
+
+int main (int argc, char *argv[]) {
+	static dec_t decs[NVALUES];
+	static ifx_int8_t int8s[NVALUES];
+	static bigint bigints[NVALUES];
+	static ifx_sqlvar_t dvars[NVALUES], ivars[NVALUES], bvars[NVALUES];
+	long cells = (argc > 1) ? atol(argv[1]) : CELLS;
+	lua_State *L = luaL_newstate();
+	fetch_opts opts;
+	char text[64];
+	int i;
+
+	srand(1985);
+	for (i = 0; i < NVALUES; i++) {
+		/* money-like values, DECIMAL(16,2) */
+		snprintf(text, sizeof(text), "%s%ld.%02d", (i % 7 == 0) ? "-" : "",
+			(long)rand() % 100000000L, rand() % 100);
+		deccvasc(text, strlen(text), decs + i);
+		dvars[i].sqltype = CDECIMALTYPE;
+		dvars[i].sqllen = PRECMAKE(16, 2);
+		dvars[i].sqldata = (char *)(decs + i);
+
+		snprintf(text, sizeof(text), "%ld%06ld", (long)rand(), (long)rand() % 1000000L);
+		ifx_int8cvasc(text, strlen(text), int8s + i);
+		ivars[i].sqltype = CINT8TYPE;
+		ivars[i].sqldata = (char *)(int8s + i);
+		bigintcvifx_int8(int8s + i, bigints + i);
+		bvars[i].sqltype = CBIGINTTYPE;
+		bvars[i].sqldata = (char *)(bigints + i);
+	}
+
+	opts.decimal = DEC_NUMBER;
+	printf("%ld cells\n", cells);
+	printf("%-16s %12s %12s %8s\n", "", "text/s", "binary/s", "speedup");
+	report("decimal", run(L, old_decimal, dvars, cells),
+		run(L, getdecoder(CDECIMALTYPE, &opts), dvars, cells),
+		check(L, old_decimal, getdecoder(CDECIMALTYPE, &opts), dvars));
+	report("int8 as bigint", run(L, old_int8, ivars, cells),
+		run(L, getdecoder(CBIGINTTYPE, &opts), bvars, cells), 0);
+	opts.decimal = DEC_STRING;
+	report("decimal string", run(L, old_decimal, dvars, cells),
+		run(L, getdecoder(CDECIMALTYPE, &opts), dvars, cells), 0);
+	opts.decimal = DEC_SCALED;
+	report("decimal scaled", run(L, old_decimal, dvars, cells),
+		run(L, getdecoder(CDECIMALTYPE, &opts), dvars, cells), 0);
+
+	lua_close(L);
+	return 0;
+}
@@ -0,0 +1,1281 @@
+/*
+** Mock ESQL/C runtime for the offline benchmarks.
+**
+** Implements the sqli_* entry points and the conversion routines the
+** driver links against, with no database server. A statement of the
+** form
+**
+**   mock rows=N cols=TYPE,TYPE*K,... [null=F] [seed=S]
+**
+** is a query whose result set is synthesized in memory: N rows of the
+** listed columns (TYPE*K repeats a type K times), a fraction F of the
+** cells NULL. The types are smallint, integer, bigint, int8, float,
+** smallfloat, decimal(p,s), money(p,s), char(n), varchar(n), date,
+** datetime (YEAR TO FRACTION(5)), time (HOUR TO SECOND), interval
+** (DAY(5) TO SECOND), interval_ym (YEAR(4) TO MONTH) and boolean.
+** "mock rows=N" without columns is a statement affecting N rows; any
+** other statement succeeds affecting none.
+**
+** Each column keeps MOCK_VALUES distinct cells in its C type, a fetch
+** copies the cells of the row into the buffer of the sqlda, so the
+** benchmarks time the driver rather than the mock.
+*/
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#ifdef IFX_THREAD
+#include <pthread.h>
+#endif
+
+#include "sqlhdr.h"
+
+#define MOCK_VALUES		64			/* distinct cells of a column */
+#define MOCK_COLS		1024		/* max columns of a result */
+#define MOCK_NAME_SIZE	64
+
+#define DATE_EPOCH		25568		/* day number of 1970-01-01, 0 is 1899-12-31 */
+
+#define SQL_SYNTAX		(-201)		/* syntax error */
+#define SQL_NOCURSOR	(-259)		/* cursor not declared */
+#define SQL_NOTOPEN		(-400)		/* fetch on a cursor not open */
+#define SQL_NOMEM		(-208)		/* memory allocation failed */
+#define SQL_INTERRUPT	(-213)		/* statement interrupted */
+#define SQL_BADDATE		(-1205)		/* invalid date */
+#define SQL_BADQUAL		(-1266)		/* incompatible qualifiers */
+
+typedef struct {
+	int2	ctype;			/* C type of the cells */
+	int4	len;			/* described length */
+	size_t	size;			/* bytes of a cell */
+	char	*cells;			/* MOCK_VALUES cells */
+	char	nulls[MOCK_VALUES];
+	char	name[16];
+} mock_col;
+
+typedef struct {
+	int		refs;
+	long	rows;
+	int		ncols;
+	mock_col	*cols;
+} mock_result;
+
+struct _ifx_cursor_struct {
+	char	name[MOCK_NAME_SIZE];
+	struct _ifx_cursor_struct *next;	/* declared cursors */
+	int		is_cursor;
+	int		open;
+	long	pos;			/* current row, 0 before the first */
+	int		nparams;		/* '?' markers of a statement */
+	mock_result	*res;	/* synthesized result, NULL for other statements */
+};
+
+
+#ifdef IFX_THREAD
+static __thread ifx_sqlca_t mock_sqlca;
+ifx_sqlca_t *ifx_sqlca (void) {
+	return &mock_sqlca;
+}
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()		pthread_mutex_lock(&mock_lock)
+#define UNLOCK()	pthread_mutex_unlock(&mock_lock)
+#else
+ifx_sqlca_t sqlca;
+#define LOCK()		((void)0)
+#define UNLOCK()	((void)0)
+#endif
+
+int4 FetBufSize = 4096;
+
+static ifx_cursor_t *cursors = NULL;
+static volatile int interrupted = 0;
+
+
+static void sql_ok (void) {
+	memset(&sqlca, 0, sizeof(ifx_sqlca_t));
+	strcpy(sqlca.sqlstate, "00000");
+}
+
+static void sql_fail (int4 code, const char *msg) {
+	memset(&sqlca, 0, sizeof(ifx_sqlca_t));
+	sqlca.sqlcode = code;
+	snprintf(sqlca.sqlerrm, sizeof(sqlca.sqlerrm), "%s", msg);
+	strcpy(sqlca.sqlstate, "IX000");
+}
+
+/*
+** Consume a pending sqlbreak. Return non zero if there was one.
+*/
+static int sql_interrupted (void) {
+	if (!interrupted)
+		return 0;
+	interrupted = 0;
+	sql_fail(SQL_INTERRUPT, "statement interrupted");
+	return 1;
+}
+
+
+/*
+** Sizes and alignment of the C types.
+*/
+mint rtypmsize (mint type, mint len) {
+	switch (type & SQLTYPE) {
+		case CCHARTYPE:
+		case CSTRINGTYPE:
+		case CVCHARTYPE:
+			return len + 1;
+		case CFIXCHARTYPE:
+		case CFIXBINTYPE:
+		case CVARBINTYPE:
+		case CLVCHARTYPE:
+		case CROWTYPE:
+		case CCOLLTYPE:
+			return len;
+		case CSHORTTYPE:
+			return sizeof(short);
+		case CINTTYPE:
+		case CDATETYPE:
+			return sizeof(int4);
+		case CLONGTYPE:
+			return sizeof(long);
+		case CBIGINTTYPE:
+			return sizeof(bigint);
+		case CFLOATTYPE:
+			return sizeof(float);
+		case CDOUBLETYPE:
+			return sizeof(double);
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+			return sizeof(dec_t);
+		case CDTIMETYPE:
+			return sizeof(dtime_t);
+		case CINVTYPE:
+			return sizeof(intrvl_t);
+		case CINT8TYPE:
+			return sizeof(ifx_int8_t);
+		case CLOCATORTYPE:
+			return sizeof(ifx_loc_t);
+		case CBOOLTYPE:
+			return sizeof(char);
+		case SQLUDTFIXED:
+			return len;
+		default:
+			return len;
+	}
+}
+
+mlong rtypalign (mlong pos, mint type) {
+	mlong a;
+
+	switch (type & SQLTYPE) {
+		case CSHORTTYPE:
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+		case CDTIMETYPE:
+		case CINVTYPE:
+			a = sizeof(short);
+			break;
+		case CINTTYPE:
+		case CDATETYPE:
+		case CFLOATTYPE:
+		case CINT8TYPE:
+			a = sizeof(int4);
+			break;
+		case CLONGTYPE:
+		case CBIGINTTYPE:
+		case CDOUBLETYPE:
+		case CLOCATORTYPE:
+			a = sizeof(void *);
+			break;
+		default:
+			return pos;
+	}
+	return (pos + a - 1) & ~(a - 1);
+}
+
+
+/*
+** DECIMAL: base-100 digits, most significant first.
+*/
+mint deccvasc (char *str, mint len, dec_t *dec) {
+	char digits[2 * DECSIZE + 2];
+	int nint = 0, nfrac = 0, n = 0, i, pad;
+	const char *p = str, *end = str + len;
+
+	memset(dec, 0, sizeof(dec_t));
+	dec->dec_pos = 1;
+	while ((p < end) && isspace((unsigned char)*p))
+		p++;
+	if ((p < end) && ((*p == '-') || (*p == '+'))) {
+		dec->dec_pos = (*p == '-') ? 0 : 1;
+		p++;
+	}
+	while ((p < end) && (*p == '0'))
+		p++;
+	/* left pad the integer part to an even number of digits */
+	for (i = 0; (p + i < end) && isdigit((unsigned char)p[i]); i++)
+		;
+	pad = i & 1;
+	if (pad)
+		digits[n++] = 0;
+	for (; (p < end) && isdigit((unsigned char)*p); p++, nint++)
+		if (n < (int)sizeof(digits))
+			digits[n++] = *p - '0';
+	if ((p < end) && (*p == '.')) {
+		for (p++; (p < end) && isdigit((unsigned char)*p); p++, nfrac++)
+			if (n < (int)sizeof(digits))
+				digits[n++] = *p - '0';
+	}
+	if ((nint == 0) && (nfrac == 0) && ((p == str) || (p[-1] != '0')))
+		return -1213;	/* not a number */
+	if (n & 1)
+		digits[n++] = 0;
+	dec->dec_exp = (nint + pad) / 2;
+	for (i = 0; i < n / 2; i++) {
+		int d = digits[2 * i] * 10 + digits[2 * i + 1];
+		if ((dec->dec_ndgts == 0) && (d == 0)) {
+			dec->dec_exp--;
+			continue;
+		}
+		if (dec->dec_ndgts < DECSIZE)
+			dec->dec_dgts[dec->dec_ndgts++] = (char)d;
+	}
+	while ((dec->dec_ndgts > 0) && (dec->dec_dgts[dec->dec_ndgts - 1] == 0))
+		dec->dec_ndgts--;
+	if (dec->dec_ndgts == 0) {
+		dec->dec_exp = 0;
+		dec->dec_pos = 1;
+	}
+	return 0;
+}
+
+/*
+** Text of a decimal, right digits after the point (truncated), or as
+** many as needed if right is -1.
+*/
+mint dectoasc (dec_t *dec, char *buf, mint len, mint right) {
+	char out[2 * DECSIZE + 80];
+	int n = 0, w, lo, d;
+
+	if (dec->dec_pos == DECPOSNULL) {
+		if (len > 0)
+			buf[0] = '\0';
+		return 0;
+	}
+	if ((dec->dec_pos == 0) && (dec->dec_ndgts > 0))
+		out[n++] = '-';
+	if (dec->dec_exp <= 0)
+		out[n++] = '0';
+	for (w = dec->dec_exp - 1; w >= 0; w--) {
+		d = (dec->dec_exp - 1 - w < dec->dec_ndgts) ? dec->dec_dgts[dec->dec_exp - 1 - w] : 0;
+		if ((w == dec->dec_exp - 1) && (d < 10))
+			out[n++] = '0' + d;
+		else {
+			out[n++] = '0' + d / 10;
+			out[n++] = '0' + d % 10;
+		}
+	}
+	lo = dec->dec_exp - dec->dec_ndgts;
+	if ((lo < 0) || (right > 0)) {
+		int start = n;
+		out[n++] = '.';
+		for (w = -1; (w >= lo) || ((right > 0) && (n - start <= right)); w--) {
+			int i = dec->dec_exp - 1 - w;
+			d = ((i >= 0) && (i < dec->dec_ndgts)) ? dec->dec_dgts[i] : 0;
+			out[n++] = '0' + d / 10;
+			out[n++] = '0' + d % 10;
+			if (n >= (int)sizeof(out) - 2)
+				break;
+		}
+		if (right >= 0)
+			n = start + 1 + right;
+		else
+			while (out[n - 1] == '0')
+				n--;
+		if (n == start + 1)
+			n = start;
+	}
+	if (n >= len) {
+		memset(buf, '*', len);
+		return -1;
+	}
+	memcpy(buf, out, n);
+	buf[n] = '\0';
+	return 0;
+}
+
+mint dectodbl (dec_t *dec, double *d) {
+	char buf[2 * DECSIZE + 80];
+
+	if (dectoasc(dec, buf, sizeof(buf), -1) != 0)
+		return -1;
+	*d = strtod(buf, NULL);
+	return 0;
+}
+
+
+/*
+** INT8: magnitude in two 32-bit words.
+*/
+static void int8_set (ifx_int8_t *v, bigint b) {
+	unsigned long long m = (b < 0) ? -(unsigned long long)b : (unsigned long long)b;
+	v->data[0] = (unsigned int)m;
+	v->data[1] = (unsigned int)(m >> 32);
+	v->sign = (b < 0) ? -1 : 1;
+}
+
+mint ifx_int8cvasc (char *str, mint len, ifx_int8_t *v) {
+	char buf[32];
+
+	if (len >= (mint)sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	int8_set(v, strtoll(buf, NULL, 10));
+	return 0;
+}
+
+mint bigintcvifx_int8 (const ifx_int8_t *v, bigint *b) {
+	unsigned long long m = ((unsigned long long)v->data[1] << 32) | v->data[0];
+
+	if (v->sign == 0)
+		return -1;
+	if (m > 0x7fffffffffffffffULL)
+		return -1200;	/* value too large */
+	*b = (v->sign < 0) ? -(bigint)m : (bigint)m;
+	return 0;
+}
+
+mint ifx_int8toasc (ifx_int8_t *v, char *str, mint len) {
+	bigint b;
+
+	if (bigintcvifx_int8(v, &b) != 0)
+		return -1;
+	return (snprintf(str, len, "%lld", b) < len) ? 0 : -1;
+}
+
+
+/*
+** DATE: days since 1899-12-31.
+*/
+static long days_from_civil (int y, int m, int d) {
+	long era;
+	int yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = ((y >= 0) ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468 + DATE_EPOCH;
+}
+
+static void civil_from_days (long z, int *y, int *m, int *d) {
+	long era, doe, yoe, doy, mp;
+
+	z += 719468 - DATE_EPOCH;
+	era = ((z >= 0) ? z : z - 146096) / 146097;
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	*d = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*m = (int)((mp < 10) ? mp + 3 : mp - 9);
+	*y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+static int valid_date (int y, int m, int d) {
+	static const int mdays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	if ((y < 1) || (y > 9999) || (m < 1) || (m > 12) || (d < 1) || (d > mdays[m - 1]))
+		return 0;
+	return (m != 2) || (d < 29) || ((y % 4 == 0) && ((y % 100 != 0) || (y % 400 == 0)));
+}
+
+mint rfmtdate (int4 jdate, const char *fmt, char *out) {
+	static const char *const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	static const char *const days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	int y, m, d;
+
+	civil_from_days(jdate, &y, &m, &d);
+	while (*fmt != '\0') {
+		if (strncasecmp(fmt, "yyyy", 4) == 0) {
+			out += sprintf(out, "%04d", y);
+			fmt += 4;
+		}
+		else if (strncasecmp(fmt, "yy", 2) == 0) {
+			out += sprintf(out, "%02d", y % 100);
+			fmt += 2;
+		}
+		else if (strncasecmp(fmt, "mmm", 3) == 0) {
+			out += sprintf(out, "%s", months[m - 1]);
+			fmt += 3;
+		}
+		else if (strncasecmp(fmt, "mm", 2) == 0) {
+			out += sprintf(out, "%02d", m);
+			fmt += 2;
+		}
+		else if (strncasecmp(fmt, "ddd", 3) == 0) {
+			out += sprintf(out, "%s", days[((jdate % 7) + 7) % 7]);
+			fmt += 3;
+		}
+		else if (strncasecmp(fmt, "dd", 2) == 0) {
+			out += sprintf(out, "%02d", d);
+			fmt += 2;
+		}
+		else
+			*out++ = *fmt++;
+	}
+	*out = '\0';
+	return 0;
+}
+
+/*
+** Read up to max digits of str. Return the number, -1 if none.
+*/
+static int read_number (char **str, int max) {
+	int v = 0, n = 0;
+
+	while ((n < max) && isdigit((unsigned char)**str)) {
+		v = v * 10 + (**str - '0');
+		(*str)++;
+		n++;
+	}
+	return (n > 0) ? v : -1;
+}
+
+mint rdefmtdate (int4 *jdate, char *fmt, char *str) {
+	int y = -1, m = -1, d = -1;
+
+	while ((*fmt != '\0') && (*str != '\0')) {
+		if (strncasecmp(fmt, "yyyy", 4) == 0) {
+			y = read_number(&str, 4);
+			fmt += 4;
+		}
+		else if (strncasecmp(fmt, "yy", 2) == 0) {
+			y = read_number(&str, 2);
+			if (y >= 0)
+				y += 1900;
+			fmt += 2;
+		}
+		else if (strncasecmp(fmt, "mm", 2) == 0) {
+			m = read_number(&str, 2);
+			fmt += 2;
+		}
+		else if (strncasecmp(fmt, "dd", 2) == 0) {
+			d = read_number(&str, 2);
+			fmt += 2;
+		}
+		else {
+			if (!isdigit((unsigned char)*str))
+				str++;
+			fmt++;
+		}
+	}
+	if (!valid_date(y, m, d))
+		return SQL_BADDATE;
+	*jdate = days_from_civil(y, m, d);
+	return 0;
+}
+
+mint rstrdate (char *str, int4 *jdate) {
+	return rdefmtdate(jdate, "mm/dd/yyyy", str);
+}
+
+mint rdatestr (int4 jdate, char *str) {
+	return rfmtdate(jdate, "mm/dd/yyyy", str);
+}
+
+
+/*
+** DATETIME and INTERVAL: base-100 digits, the seconds at weight 0,
+** the fraction at weights -1 to -3. A DATETIME has the year at weights
+** 6 and 5, the month at 4 and the day at 3; an INTERVAL has its
+** leading field at as many weights as it needs.
+*/
+#define F_YEAR		0
+#define F_MONTH		1
+#define F_DAY		2
+#define F_HOUR		3
+#define F_MINUTE	4
+#define F_SECOND	5
+#define F_FRAC		6			/* in 1e-5 seconds */
+#define NFIELDS		7
+
+static int tu_field (int tu) {
+	return (tu <= TU_SECOND) ? tu / 2 : F_FRAC;
+}
+
+/* lowest weight of the digits of a qualifier */
+static int tu_low (int tu) {
+	static const int low[] = {5, 4, 3, 2, 1, 0};
+	if (tu <= TU_SECOND)
+		return low[tu / 2];
+	return -((tu - TU_SECOND + 1) / 2);
+}
+
+static int dec_get (const dec_t *dec, int w) {
+	int i = dec->dec_exp - 1 - w;
+	return ((i >= 0) && (i < dec->dec_ndgts)) ? dec->dec_dgts[i] : 0;
+}
+
+/* keep the first n of the 5 fraction digits */
+static int frac_trunc (int frac, int end) {
+	static const int unit[] = {100000, 10000, 1000, 100, 10, 1};
+	int n = (end > TU_SECOND) ? end - TU_SECOND : 0;
+	return frac - frac % unit[n];
+}
+
+static void frac_put (dec_t *dec, int frac, int low) {
+	int digits[3];
+	int w;
+
+	digits[0] = frac / 1000;
+	digits[1] = (frac / 10) % 100;
+	digits[2] = (frac % 10) * 10;
+	for (w = -1; w >= low; w--)
+		dec->dec_dgts[dec->dec_ndgts++] = (char)digits[-w - 1];
+}
+
+static int frac_get (const dec_t *dec) {
+	return dec_get(dec, -1) * 1000 + dec_get(dec, -2) * 10 + dec_get(dec, -3) / 10;
+}
+
+static void dt_unpack (const dtime_t *dt, int v[NFIELDS]) {
+	const dec_t *dec = &(dt->dt_dec);
+	int f, start = tu_field(TU_START(dt->dt_qual)), end = tu_field(TU_END(dt->dt_qual));
+
+	for (f = start; f <= end; f++) {
+		switch (f) {
+			case F_YEAR:
+				v[f] = dec_get(dec, 6) * 100 + dec_get(dec, 5);
+				break;
+			case F_FRAC:
+				v[f] = frac_get(dec);
+				break;
+			default:
+				v[f] = dec_get(dec, 5 - f);
+		}
+	}
+}
+
+static void dt_pack (dtime_t *dt, const int v[NFIELDS]) {
+	dec_t *dec = &(dt->dt_dec);
+	int f, start = tu_field(TU_START(dt->dt_qual)), end = tu_field(TU_END(dt->dt_qual));
+
+	dec->dec_pos = 1;
+	dec->dec_ndgts = 0;
+	dec->dec_exp = (start == F_YEAR) ? 7 : (start == F_FRAC) ? 0 : 6 - start;
+	for (f = start; (f <= end) && (f < F_FRAC); f++) {
+		if (f == F_YEAR) {
+			dec->dec_dgts[dec->dec_ndgts++] = (char)(v[f] / 100);
+			dec->dec_dgts[dec->dec_ndgts++] = (char)(v[f] % 100);
+		}
+		else
+			dec->dec_dgts[dec->dec_ndgts++] = (char)v[f];
+	}
+	if (end == F_FRAC)
+		frac_put(dec, frac_trunc(v[F_FRAC], TU_END(dt->dt_qual)), tu_low(TU_END(dt->dt_qual)));
+}
+
+mint dtextend (dtime_t *src, dtime_t *dst) {
+	int v[NFIELDS];
+	time_t now = time(NULL);
+	struct tm tm;
+
+	/* leading fields from the current time, trailing ones from zero */
+	localtime_r(&now, &tm);
+	v[F_YEAR] = tm.tm_year + 1900;
+	v[F_MONTH] = tm.tm_mon + 1;
+	v[F_DAY] = tm.tm_mday;
+	v[F_HOUR] = v[F_MINUTE] = v[F_SECOND] = v[F_FRAC] = 0;
+	if (tu_field(TU_END(src->dt_qual)) < F_DAY)
+		v[F_DAY] = 1;
+	if (tu_field(TU_END(src->dt_qual)) < F_MONTH)
+		v[F_MONTH] = 1;
+	dt_unpack(src, v);
+	dt_pack(dst, v);
+	return 0;
+}
+
+mint dttoasc (dtime_t *dt, char *str) {
+	static const char *const seps = " -- ::.";
+	int v[NFIELDS];
+	int f, start = tu_field(TU_START(dt->dt_qual)), end = tu_field(TU_END(dt->dt_qual));
+
+	dt_unpack(dt, v);
+	for (f = start; f <= end; f++) {
+		if (f > start)
+			*str++ = seps[f];
+		if (f == F_YEAR)
+			str += sprintf(str, "%04d", v[f]);
+		else if (f == F_FRAC)
+			str += sprintf(str, "%05d", v[f]) - (TU_F5 - TU_END(dt->dt_qual));
+		else
+			str += sprintf(str, "%02d", v[f]);
+	}
+	*str = '\0';
+	return 0;
+}
+
+/* units of the fields of the two interval classes */
+static const long long in_units[NFIELDS] = {12, 1,
+	86400LL * 100000, 3600LL * 100000, 60LL * 100000, 100000, 1};
+
+static long long in_unpack (const intrvl_t *in) {
+	const dec_t *dec = &(in->in_dec);
+	int start = tu_field(TU_START(in->in_qual)), end = tu_field(TU_END(in->in_qual));
+	int f, w, base;
+	long long total = 0, lead = 0;
+
+	base = (start <= F_MONTH) ? 1 - start : 5 - start;
+	if (start == F_FRAC)
+		base = -1;
+	for (w = dec->dec_exp - 1; w >= base; w--)
+		lead = lead * 100 + dec_get(dec, w);
+	if (start == F_FRAC)
+		lead = frac_get(dec);
+	total = lead * in_units[start];
+	for (f = start + 1; f <= end; f++)
+		total += ((f == F_FRAC) ? frac_get(dec) : dec_get(dec, (f <= F_MONTH) ? 1 - f : 5 - f)) * in_units[f];
+	return (dec->dec_pos == 0) ? -total : total;
+}
+
+static void in_pack (intrvl_t *in, long long total) {
+	dec_t *dec = &(in->in_dec);
+	int start = tu_field(TU_START(in->in_qual)), end = tu_field(TU_END(in->in_qual));
+	unsigned long long m = (total < 0) ? -total : total;
+	char lead[10];
+	int f, n = 0;
+	long long v;
+
+	dec->dec_pos = (total < 0) ? 0 : 1;
+	dec->dec_ndgts = 0;
+	if (start == F_FRAC) {
+		dec->dec_exp = 0;
+		frac_put(dec, frac_trunc((int)(m % 100000), TU_END(in->in_qual)), tu_low(TU_END(in->in_qual)));
+		return;
+	}
+	v = m / in_units[start];
+	m %= in_units[start];
+	do {
+		lead[n++] = (char)(v % 100);
+		v /= 100;
+	} while (v > 0);
+	dec->dec_exp = n + ((start <= F_MONTH) ? 1 - start : 5 - start);
+	while (n > 0)
+		dec->dec_dgts[dec->dec_ndgts++] = lead[--n];
+	for (f = start + 1; (f <= end) && (f < F_FRAC); f++) {
+		dec->dec_dgts[dec->dec_ndgts++] = (char)(m / in_units[f]);
+		m %= in_units[f];
+	}
+	if (end == F_FRAC)
+		frac_put(dec, frac_trunc((int)m, TU_END(in->in_qual)), tu_low(TU_END(in->in_qual)));
+}
+
+mint invextend (intrvl_t *src, intrvl_t *dst) {
+	if ((TU_START(src->in_qual) <= TU_MONTH) != (TU_START(dst->in_qual) <= TU_MONTH))
+		return SQL_BADQUAL;
+	in_pack(dst, in_unpack(src));
+	return 0;
+}
+
+mint intoasc (intrvl_t *in, char *str) {
+	static const char *const seps = " -- ::.";
+	int start = tu_field(TU_START(in->in_qual)), end = tu_field(TU_END(in->in_qual));
+	long long total = in_unpack(in);
+	unsigned long long m = (total < 0) ? -total : total;
+	int f;
+
+	if (total < 0)
+		*str++ = '-';
+	for (f = start; f <= end; f++) {
+		long long v = (long long)(m / in_units[f]);
+		m %= in_units[f];
+		if (f == start)
+			str += sprintf(str, "%lld", v);
+		else if (f == F_FRAC)
+			str += sprintf(str, "%c%05lld", seps[f], v) - (TU_F5 - TU_END(in->in_qual));
+		else
+			str += sprintf(str, "%c%02lld", seps[f], v);
+	}
+	*str = '\0';
+	return 0;
+}
+
+
+/*
+** Synthesized result sets.
+*/
+static unsigned long mock_rand (unsigned long *seed) {
+	*seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (unsigned long)(*seed >> 33);
+}
+
+static void result_free (mock_result *res) {
+	int i;
+
+	if ((res == NULL) || (--res->refs > 0))
+		return;
+	for (i = 0; i < res->ncols; i++)
+		free(res->cols[i].cells);
+	free(res->cols);
+	free(res);
+}
+
+/*
+** Fill the cells of a column with values of its type.
+*/
+static void fill_cells (mock_col *col, unsigned long *seed, double nulls) {
+	int i, k, n;
+
+	for (i = 0; i < MOCK_VALUES; i++) {
+		char *cell = col->cells + i * col->size;
+		unsigned long r = mock_rand(seed);
+		char text[64];
+
+		col->nulls[i] = ((double)(mock_rand(seed) % 10000) < nulls * 10000);
+		switch (col->ctype) {
+			case CSHORTTYPE:
+				*(short *)cell = (short)(r % 32768) - 16384;
+				break;
+			case CINTTYPE:
+				*(int4 *)cell = (int4)(r & 0x7fffffff) - 0x3fffffff;
+				break;
+			case CBIGINTTYPE:
+				*(bigint *)cell = ((bigint)r << 16) - ((bigint)1 << 46);
+				break;
+			case CINT8TYPE:
+				int8_set((ifx_int8_t *)cell, ((bigint)r << 16) - ((bigint)1 << 46));
+				break;
+			case CFLOATTYPE:
+				*(float *)cell = (float)(r % 1000000) / 1000;
+				break;
+			case CDOUBLETYPE:
+				*(double *)cell = (double)(r % 1000000000) / 1000;
+				break;
+			case CDECIMALTYPE:
+			case CMONEYTYPE:
+				{
+					int p = PRECTOT(col->len), s = PRECDEC(col->len);
+					n = 0;
+					if (r & 1)
+						text[n++] = '-';
+					for (k = 0; k < p - s; k++)
+						text[n++] = '0' + mock_rand(seed) % 10;
+					text[n++] = '.';
+					for (k = 0; k < s; k++)
+						text[n++] = '0' + mock_rand(seed) % 10;
+					deccvasc(text, n, (dec_t *)cell);
+				}
+				break;
+			case CCHARTYPE:
+			case CVCHARTYPE:
+				n = 1 + (int)(r % col->len);
+				for (k = 0; k < n; k++)
+					cell[k] = 'a' + mock_rand(seed) % 26;
+				if (col->ctype == CCHARTYPE) {
+					memset(cell + n, ' ', col->len - n);
+					n = col->len;
+				}
+				cell[n] = '\0';
+				break;
+			case CDATETYPE:
+				*(int4 *)cell = days_from_civil(1990, 1, 1) + (int4)(r % 14600);
+				break;
+			case CDTIMETYPE:
+				{
+					int v[NFIELDS];
+					v[F_YEAR] = 1990 + r % 40;
+					v[F_MONTH] = 1 + mock_rand(seed) % 12;
+					v[F_DAY] = 1 + mock_rand(seed) % 28;
+					v[F_HOUR] = mock_rand(seed) % 24;
+					v[F_MINUTE] = mock_rand(seed) % 60;
+					v[F_SECOND] = mock_rand(seed) % 60;
+					v[F_FRAC] = mock_rand(seed) % 100000;
+					((dtime_t *)cell)->dt_qual = col->len;
+					dt_pack((dtime_t *)cell, v);
+				}
+				break;
+			case CINVTYPE:
+				((intrvl_t *)cell)->in_qual = col->len;
+				if (TU_START(col->len) <= TU_MONTH)
+					in_pack((intrvl_t *)cell, (long long)(r % 120000) - 60000);
+				else
+					in_pack((intrvl_t *)cell, (long long)(r % 8640000000ULL) * 100000 - 432000000000000LL);
+				break;
+			case CBOOLTYPE:
+				*cell = (char)((r >> 8) & 1);
+				break;
+		}
+	}
+}
+
+/*
+** Parse the type at *p into col. Return 0, or -1 if it is unknown.
+*/
+static int parse_type (const char **p, mock_col *col) {
+	static const struct {
+		const char *name;
+		int2 ctype;
+		int4 len;
+	} types[] = {
+		{"smallint", CSHORTTYPE, sizeof(short)},
+		{"integer", CINTTYPE, sizeof(int4)},
+		{"int8", CINT8TYPE, sizeof(ifx_int8_t)},
+		{"int", CINTTYPE, sizeof(int4)},
+		{"bigint", CBIGINTTYPE, sizeof(bigint)},
+		{"smallfloat", CFLOATTYPE, sizeof(float)},
+		{"float", CDOUBLETYPE, sizeof(double)},
+		{"decimal", CDECIMALTYPE, PRECMAKE(16, 2)},
+		{"money", CMONEYTYPE, PRECMAKE(16, 2)},
+		{"char", CCHARTYPE, 1},
+		{"varchar", CVCHARTYPE, 255},
+		{"date", CDATETYPE, sizeof(int4)},
+		{"datetime", CDTIMETYPE, TU_DTENCODE(TU_YEAR, TU_F5)},
+		{"time", CDTIMETYPE, TU_DTENCODE(TU_HOUR, TU_SECOND)},
+		{"interval_ym", CINVTYPE, TU_IENCODE(4, TU_YEAR, TU_MONTH)},
+		{"interval", CINVTYPE, TU_IENCODE(5, TU_DAY, TU_SECOND)},
+		{"boolean", CBOOLTYPE, sizeof(char)},
+		{NULL, 0, 0}
+	};
+	size_t n;
+	int i;
+
+	for (n = 0; isalnum((unsigned char)(*p)[n]) || ((*p)[n] == '_'); n++)
+		;
+	for (i = 0; types[i].name != NULL; i++)
+		if ((strlen(types[i].name) == n) && (strncasecmp(*p, types[i].name, n) == 0))
+			break;
+	if (types[i].name == NULL)
+		return -1;
+	*p += n;
+	col->ctype = types[i].ctype;
+	col->len = types[i].len;
+	if (**p == '(') {
+		char *end;
+		long a = strtol(*p + 1, &end, 10), b = 0;
+		if (*end == ',')
+			b = strtol(end + 1, &end, 10);
+		if ((*end != ')') || (a <= 0) || (a > 32767) || (b < 0) || (b > a))
+			return -1;
+		*p = end + 1;
+		if ((col->ctype == CDECIMALTYPE) || (col->ctype == CMONEYTYPE)) {
+			if (a > 2 * DECSIZE)
+				return -1;
+			col->len = PRECMAKE(a, b);
+		}
+		else if ((col->ctype == CCHARTYPE) || (col->ctype == CVCHARTYPE))
+			col->len = a;
+		else
+			return -1;
+	}
+	col->size = rtypmsize(col->ctype, col->len);
+	return 0;
+}
+
+/*
+** Parse a mock statement. Return the result, or NULL with sqlca set.
+*/
+static mock_result *parse_mock (const char *sql) {
+	mock_result *res = (mock_result *)calloc(1, sizeof(mock_result));
+	unsigned long seed = 1985;
+	double nulls = 0;
+	const char *p = sql + 4;
+	int i;
+
+	if (res == NULL) {
+		sql_fail(SQL_NOMEM, "out of memory");
+		return NULL;
+	}
+	res->refs = 1;
+	res->cols = (mock_col *)calloc(MOCK_COLS, sizeof(mock_col));
+	if (res->cols == NULL) {
+		free(res);
+		sql_fail(SQL_NOMEM, "out of memory");
+		return NULL;
+	}
+	while (*p != '\0') {
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p == '\0')
+			break;
+		if (strncasecmp(p, "rows=", 5) == 0)
+			res->rows = strtol(p + 5, (char **)&p, 10);
+		else if (strncasecmp(p, "null=", 5) == 0)
+			nulls = strtod(p + 5, (char **)&p);
+		else if (strncasecmp(p, "seed=", 5) == 0)
+			seed = strtoul(p + 5, (char **)&p, 10);
+		else if (strncasecmp(p, "cols=", 5) == 0) {
+			p += 5;
+			do {
+				mock_col col;
+				long k, repeat = 1;
+				memset(&col, 0, sizeof(mock_col));
+				if (parse_type(&p, &col) != 0)
+					goto syntax;
+				if (*p == '*')
+					repeat = strtol(p + 1, (char **)&p, 10);
+				if ((repeat <= 0) || (res->ncols + repeat > MOCK_COLS))
+					goto syntax;
+				for (k = 0; k < repeat; k++) {
+					res->cols[res->ncols] = col;
+					snprintf(res->cols[res->ncols].name, sizeof(col.name), "c%d", res->ncols + 1);
+					res->ncols++;
+				}
+			} while ((*p == ',') && p++);
+		}
+		else
+			goto syntax;
+	}
+	for (i = 0; i < res->ncols; i++) {
+		mock_col *col = res->cols + i;
+		col->cells = (char *)calloc(MOCK_VALUES, col->size);
+		if (col->cells == NULL) {
+			res->ncols = i;
+			result_free(res);
+			sql_fail(SQL_NOMEM, "out of memory");
+			return NULL;
+		}
+		fill_cells(col, &seed, nulls);
+	}
+	return res;
+
+syntax:
+	sql_fail(SQL_SYNTAX, p);
+	res->ncols = 0;
+	result_free(res);
+	return NULL;
+}
+
+/*
+** Copy the cells of row pos into the buffers of sqlda.
+*/
+static void fill_row (mock_result *res, long pos, ifx_sqlda_t *sqlda) {
+	int v = (int)((pos - 1) % MOCK_VALUES);
+	int i;
+
+	for (i = 0; (i < sqlda->sqld) && (i < res->ncols); i++) {
+		mock_col *col = res->cols + i;
+		ifx_sqlvar_t *sqlvar = sqlda->sqlvar + i;
+		char *cell = col->cells + v * col->size;
+
+		if (sqlvar->sqlind != NULL)
+			*(sqlvar->sqlind) = col->nulls[v] ? -1 : 0;
+		if (col->nulls[v])
+			continue;
+		switch (sqlvar->sqltype) {
+			case CCHARTYPE:
+			case CVCHARTYPE:
+			case CSTRINGTYPE:
+				{
+					size_t n = strlen(cell);
+					if (n > (size_t)sqlvar->sqllen - 1)
+						n = sqlvar->sqllen - 1;
+					memcpy(sqlvar->sqldata, cell, n);
+					sqlvar->sqldata[n] = '\0';
+				}
+				break;
+			case CBIGINTTYPE:
+				if (col->ctype == CINT8TYPE)
+					bigintcvifx_int8((ifx_int8_t *)cell, (bigint *)sqlvar->sqldata);
+				else
+					memcpy(sqlvar->sqldata, cell, sizeof(bigint));
+				break;
+			default:
+				memcpy(sqlvar->sqldata, cell, col->size);
+		}
+	}
+}
+
+
+/*
+** Statements and cursors.
+*/
+ifx_cursor_t *sqli_prep (mint ver, char *name, const char *sql, ifx_literal_t *lit, ifx_namelist_t *names, mint a, mint b, mint c) {
+	ifx_cursor_t *stmt;
+	const char *p;
+	int quote = 0;
+
+	if (sql_interrupted())
+		return NULL;
+	stmt = (ifx_cursor_t *)calloc(1, sizeof(ifx_cursor_t));
+	if (stmt == NULL) {
+		sql_fail(SQL_NOMEM, "out of memory");
+		return NULL;
+	}
+	snprintf(stmt->name, sizeof(stmt->name), "%s", (name != NULL) ? name : "");
+	while (isspace((unsigned char)*sql))
+		sql++;
+	if ((strncasecmp(sql, "mock", 4) == 0) && ((sql[4] == '\0') || isspace((unsigned char)sql[4]))) {
+		stmt->res = parse_mock(sql);
+		if (stmt->res == NULL) {
+			free(stmt);
+			return NULL;
+		}
+	}
+	for (p = sql; *p != '\0'; p++) {
+		if ((*p == '\'') || (*p == '"'))
+			quote = (quote == *p) ? 0 : (quote == 0) ? *p : quote;
+		else if ((*p == '?') && (quote == 0))
+			stmt->nparams++;
+	}
+	sql_ok();
+	return stmt;
+}
+
+static ifx_sqlda_t *alloc_sqlda (int n, size_t names) {
+	ifx_sqlda_t *sqlda = (ifx_sqlda_t *)calloc(1, sizeof(ifx_sqlda_t) + n * sizeof(ifx_sqlvar_t) + names);
+	if (sqlda != NULL) {
+		sqlda->sqld = n;
+		sqlda->sqlvar = (ifx_sqlvar_t *)(sqlda + 1);
+	}
+	return sqlda;
+}
+
+/*
+** Describe the columns of a query in a single allocation, freed by
+** the caller with free().
+*/
+void sqli_describe_stmt (mint ver, ifx_cursor_t *stmt, ifx_sqlda_t **psqlda, char *name) {
+	int n = ((stmt != NULL) && (stmt->res != NULL)) ? stmt->res->ncols : 0;
+	ifx_sqlda_t *sqlda = alloc_sqlda(n, n * sizeof(((mock_col *)0)->name));
+	char *p;
+	int i;
+
+	*psqlda = sqlda;
+	if (sqlda == NULL) {
+		sql_fail(SQL_NOMEM, "out of memory");
+		return;
+	}
+	p = (char *)(sqlda->sqlvar + n);
+	for (i = 0; i < n; i++) {
+		mock_col *col = stmt->res->cols + i;
+		sqlda->sqlvar[i].sqltype = col->ctype;
+		sqlda->sqlvar[i].sqllen = col->len;
+		sqlda->sqlvar[i].sqlname = p;
+		strcpy(p, col->name);
+		p += sizeof(col->name);
+	}
+	sql_ok();
+}
+
+void sqli_describe_input_stmt (mint ver, ifx_cursor_t *stmt, ifx_sqlda_t **psqlda, char *name) {
+	int n = (stmt != NULL) ? stmt->nparams : 0;
+	ifx_sqlda_t *sqlda = alloc_sqlda(n, 0);
+	int i;
+
+	*psqlda = sqlda;
+	if (sqlda == NULL) {
+		sql_fail(SQL_NOMEM, "out of memory");
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		sqlda->sqlvar[i].sqltype = SQLVCHAR;
+		sqlda->sqlvar[i].sqllen = 255;
+		sqlda->sqlvar[i].sqlname = "";
+	}
+	sql_ok();
+}
+
+void sqli_exec (mint ver, ifx_cursor_t *stmt, ifx_sqlda_t *in, char *a, struct value *b, ifx_sqlda_t *out, char *c, struct value *d, mint e) {
+	if (sql_interrupted())
+		return;
+	sql_ok();
+	if ((stmt != NULL) && (stmt->res != NULL) && (stmt->res->ncols == 0))
+		sqlca.sqlerrd[2] = (int4)stmt->res->rows;
+}
+
+ifx_cursor_t *sqli_curs_locate (mint ver, char *name, mint flag) {
+	ifx_cursor_t *c;
+
+	LOCK();
+	for (c = cursors; c != NULL; c = c->next)
+		if (strcmp(c->name, name) == 0)
+			break;
+	if ((c == NULL) && (flag == 512)) {
+		c = (ifx_cursor_t *)calloc(1, sizeof(ifx_cursor_t));
+		if (c != NULL) {
+			snprintf(c->name, sizeof(c->name), "%s", name);
+			c->is_cursor = 1;
+			c->next = cursors;
+			cursors = c;
+		}
+	}
+	UNLOCK();
+	if (c == NULL)
+		sql_fail((flag == 512) ? SQL_NOMEM : SQL_NOCURSOR, name);
+	return c;
+}
+
+void sqli_curs_decl_dynm (mint ver, ifx_cursor_t *curs, char *name, ifx_cursor_t *stmt, mint flags, mint a) {
+	if (curs == NULL)
+		return;
+	result_free(curs->res);
+	curs->res = (stmt != NULL) ? stmt->res : NULL;
+	if (curs->res != NULL)
+		curs->res->refs++;
+	curs->open = 0;
+	sql_ok();
+}
+
+void sqli_curs_open (mint ver, ifx_cursor_t *curs, ifx_sqlda_t *in, char *a, struct value *b, mint c, mint d) {
+	if ((curs == NULL) || sql_interrupted())
+		return;
+	curs->open = 1;
+	curs->pos = 0;
+	sql_ok();
+}
+
+void sqli_curs_fetch (mint ver, ifx_cursor_t *curs, ifx_sqlda_t *in, ifx_sqlda_t *out, char *name, _FetchSpec *fs) {
+	long rows, pos;
+
+	if (curs == NULL)
+		return;
+	if (!curs->open || (curs->res == NULL)) {
+		sql_fail(SQL_NOTOPEN, curs->name);
+		return;
+	}
+	if (sql_interrupted())
+		return;
+	rows = curs->res->rows;
+	switch (fs->fdir) {
+		case 2:		pos = curs->pos - 1; break;				/* PRIOR */
+		case 3:		pos = 1; break;							/* FIRST */
+		case 4:		pos = rows; break;						/* LAST */
+		case 6:		pos = curs->pos + fs->fval; break;		/* RELATIVE */
+		case 7:		pos = fs->fval; break;					/* ABSOLUTE */
+		default:	pos = curs->pos + 1;					/* NEXT */
+	}
+	sql_ok();
+	if ((pos < 1) || (pos > rows)) {
+		curs->pos = (pos < 1) ? 0 : rows + 1;
+		sqlca.sqlcode = 100;
+		strcpy(sqlca.sqlstate, "02000");
+		return;
+	}
+	curs->pos = pos;
+	fill_row(curs->res, pos, out);
+	sqlca.sqlerrd[2] = 1;
+}
+
+void sqli_curs_put (mint ver, ifx_cursor_t *curs, ifx_sqlda_t *in, char *name) {
+	if ((curs == NULL) || sql_interrupted())
+		return;
+	sql_ok();
+	sqlca.sqlerrd[2] = 1;
+}
+
+void sqli_curs_flush (mint ver, ifx_cursor_t *curs) {
+	if (curs == NULL)
+		return;
+	sql_ok();
+}
+
+void sqli_curs_close (mint ver, ifx_cursor_t *curs) {
+	if (curs == NULL)
+		return;
+	curs->open = 0;
+	sql_ok();
+}
+
+/*
+** Free a cursor or a prepared statement.
+*/
+void sqli_curs_free (mint ver, ifx_cursor_t *curs) {
+	ifx_cursor_t **p;
+
+	if (curs == NULL)
+		return;
+	if (curs->is_cursor) {
+		LOCK();
+		for (p = &cursors; *p != NULL; p = &((*p)->next))
+			if (*p == curs) {
+				*p = curs->next;
+				break;
+			}
+		UNLOCK();
+	}
+	result_free(curs->res);
+	free(curs);
+	sql_ok();
+}
+
+
+/*
+** Connections and transactions always succeed.
+*/
+void sqli_connect_open (mint ver, mint a, const char *db, char *name, ifx_conn_t *user, mint b) {
+	sql_ok();
+}
+
+void sqli_connect_set (mint ver, char *name, mint dormant) {
+	sql_ok();
+}
+
+void sqli_connect_close (mint ver, char *name, mint a, mint b) {
+	sql_ok();
+}
+
+void sqli_trans_begin2 (mint a) {
+	sql_ok();
+}
+
+void sqli_trans_commit (void) {
+	sql_ok();
+}
+
+void sqli_trans_rollback (void) {
+	sql_ok();
+}
+
+void *ifx_alloc_conn_user (const char *user, const char *password) {
+	return malloc(1);
+}
+
+void ifx_free_conn_user (ifx_conn_t **conn) {
+	free(*conn);
+	*conn = NULL;
+}
+
+mint sqlbreak (void) {
+	interrupted = 1;
+	return 0;
+}
+
+mint sqlbreakcallback (int4 timeout, void (*callback)(mint)) {
+	return 0;
+}
+
+
+/*
+** The mock has no large objects.
+*/
+mint ifx_lo_open (ifx_lo_t *lo, mint flags, mint *err) {
+	*err = -9810;
+	return -1;
+}
+
+mint ifx_lo_read (mint fd, char *buf, mint len, mint *err) {
+	*err = -9810;
+	return -1;
+}
+
+mint ifx_lo_close (mint fd) {
+	return -1;
+}
+
+mint ifx_lo_stat (mint fd, ifx_lo_stat_t **st) {
+	return -9810;
+}
+
+mint ifx_lo_stat_size (ifx_lo_stat_t *st, ifx_int8_t *size) {
+	return -9810;
+}
+
+mint ifx_lo_stat_free (ifx_lo_stat_t *st) {
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+** Structures and entry points of the mock ESQL/C runtime, see mock.c.
+** Only the part of the ESQL/C interface the driver uses is here; the
+** layouts are the mock's own and need not match a real ESQL/C.
+*/
+#ifndef MOCK_SQLHDR_H
+#define MOCK_SQLHDR_H
+
+#include "sqltypes.h"
+
+typedef short int2;
+typedef int int4;
+typedef int mint;
+typedef long mlong;
+typedef long long bigint;
+
+#define ESQLINTVERSION	1
+
+typedef struct sqlca_s {
+	int4 sqlcode;
+	char sqlerrm[72];
+	char sqlerrp[8];
+	int4 sqlerrd[6];
+	struct sqlcaw_s {
+		char sqlwarn0, sqlwarn1, sqlwarn2, sqlwarn3;
+		char sqlwarn4, sqlwarn5, sqlwarn6, sqlwarn7;
+	} sqlwarn;
+	char sqlstate[6];
+} ifx_sqlca_t;
+
+#ifdef IFX_THREAD
+extern ifx_sqlca_t *ifx_sqlca (void);
+#define sqlca (*ifx_sqlca())
+#else
+extern ifx_sqlca_t sqlca;
+#endif
+extern int4 FetBufSize;
+
+typedef struct sqlvar_struct {
+	int2 sqltype;
+	int4 sqllen;
+	char *sqldata;
+	int2 *sqlind;
+	char *sqlname;
+	char *sqlformat;
+	int2 sqlitype;
+	int2 sqlilen;
+	char *sqlidata;
+	int4 sqlxid;
+	char *sqltypename;
+	int2 sqltypelen;
+	int2 sqlownerlen;
+	int2 sqlsourcetype;
+	char *sqlownername;
+	int4 sqlsourceid;
+	char *sqlilongdata;
+	int4 sqlflags;
+	void *sqlreserved;
+} ifx_sqlvar_t;
+
+typedef struct sqlda {
+	int2 sqld;
+	ifx_sqlvar_t *sqlvar;
+	char desc_name[19];
+	int2 desc_occ;
+	struct sqlda *desc_next;
+	void *reserved;
+} ifx_sqlda_t;
+
+/* value = 0.dgts * 100^dec_exp, dec_pos 1 positive, 0 negative */
+#define DECSIZE		16
+typedef struct decimal {
+	int2 dec_exp;
+	int2 dec_pos;
+	int2 dec_ndgts;
+	char dec_dgts[DECSIZE];
+} dec_t;
+
+#define PRECTOT(len)		(((len) >> 8) & 0xff)
+#define PRECDEC(len)		((len) & 0xff)
+#define PRECMAKE(len, dig)	(((len) << 8) + (dig))
+#define DECPOSNULL			(-1)
+
+typedef struct dtime {
+	int2 dt_qual;
+	dec_t dt_dec;
+} dtime_t;
+
+typedef struct intrvl {
+	int2 in_qual;
+	dec_t in_dec;
+} intrvl_t;
+
+#define TU_YEAR		0
+#define TU_MONTH	2
+#define TU_DAY		4
+#define TU_HOUR		6
+#define TU_MINUTE	8
+#define TU_SECOND	10
+#define TU_FRAC		12
+#define TU_F1		11
+#define TU_F2		12
+#define TU_F3		13
+#define TU_F4		14
+#define TU_F5		15
+
+#define TU_END(qual)			((qual) & 0xf)
+#define TU_START(qual)			(((qual) >> 4) & 0xf)
+#define TU_LEN(qual)			(((qual) >> 8) & 0xff)
+#define TU_ENCODE(len, s, e)	(((len) << 8) | ((s) << 4) | (e))
+#define TU_DTENCODE(s, e)		TU_ENCODE(((e) - (s) + ((s) == TU_YEAR ? 4 : 2)), s, e)
+#define TU_IENCODE(len, s, e)	TU_ENCODE(((e) - (s) + (len)), s, e)
+
+/* magnitude in two 32-bit words, sign 1 or -1, 0 for null */
+typedef struct ifx_int8 {
+	unsigned int data[2];
+	int2 sign;
+} ifx_int8_t;
+
+typedef struct ifx_lo_ts {
+	char loc[72];
+} ifx_lo_t;
+typedef struct ifx_lostat ifx_lo_stat_t;
+
+#define LO_RDONLY	0x4
+#define LO_WRONLY	0x8
+#define LO_APPEND	0x1
+#define LO_RDWR		0x10
+#define LO_BUFFER	0x20
+#define LO_NOBUFFER	0x40
+
+typedef struct tag_loc_t {
+	int2 loc_loctype;
+	union {
+		struct {
+			int4 lc_bufsize;
+			char *lc_buffer;
+			char *lc_currdata;
+			mint lc_mflags;
+		} lc_mem;
+		struct {
+			char *lc_fname;
+			mint lc_mode;
+			mint lc_fd;
+			int4 lc_position;
+		} lc_file;
+	} lc_union;
+	int4 loc_indicator;
+	int4 loc_type;
+	int4 loc_size;
+	mint loc_status;
+	char *loc_user_env;
+	int4 loc_xfercount;
+	mint (*loc_open) (struct tag_loc_t *loc, mint flag, mint bsize);
+	mint (*loc_close) (struct tag_loc_t *loc);
+	mint (*loc_read) (struct tag_loc_t *loc, char *buffer, mint buflen);
+	mint (*loc_write) (struct tag_loc_t *loc, char *buffer, mint buflen);
+	mint loc_oflags;
+} ifx_loc_t;
+
+#define loc_fname		lc_union.lc_file.lc_fname
+#define loc_fd			lc_union.lc_file.lc_fd
+#define loc_position	lc_union.lc_file.lc_position
+#define loc_bufsize		lc_union.lc_mem.lc_bufsize
+#define loc_buffer		lc_union.lc_mem.lc_buffer
+#define loc_currdata	lc_union.lc_mem.lc_currdata
+#define loc_mflags		lc_union.lc_mem.lc_mflags
+
+#define LOCMEMORY		1
+#define LOCFILE			2
+#define LOCFNAME		3
+#define LOCUSER			4
+#define LOC_RONLY		0x1
+#define LOC_WONLY		0x2
+#define LOC_APPEND		0x4
+#define LOC_TEMPFILE	0x8
+#define LOC_ALLOC		0x1
+
+typedef struct {
+	int4 fval;
+	mint fdir;
+	int4 findchk;
+} _FetchSpec;
+
+typedef struct _ifx_cursor_struct ifx_cursor_t;
+typedef struct ifx_literal ifx_literal_t;
+typedef struct ifx_namelist ifx_namelist_t;
+typedef struct ifx_connect ifx_conn_t;
+struct value;
+
+extern ifx_cursor_t *sqli_prep (mint, char *, const char *, ifx_literal_t *, ifx_namelist_t *, mint, mint, mint);
+extern void sqli_describe_stmt (mint, ifx_cursor_t *, ifx_sqlda_t **, char *);
+extern void sqli_describe_input_stmt (mint, ifx_cursor_t *, ifx_sqlda_t **, char *);
+extern void sqli_exec (mint, ifx_cursor_t *, ifx_sqlda_t *, char *, struct value *, ifx_sqlda_t *, char *, struct value *, mint);
+extern ifx_cursor_t *sqli_curs_locate (mint, char *, mint);
+extern void sqli_curs_decl_dynm (mint, ifx_cursor_t *, char *, ifx_cursor_t *, mint, mint);
+extern void sqli_curs_open (mint, ifx_cursor_t *, ifx_sqlda_t *, char *, struct value *, mint, mint);
+extern void sqli_curs_fetch (mint, ifx_cursor_t *, ifx_sqlda_t *, ifx_sqlda_t *, char *, _FetchSpec *);
+extern void sqli_curs_put (mint, ifx_cursor_t *, ifx_sqlda_t *, char *);
+extern void sqli_curs_flush (mint, ifx_cursor_t *);
+extern void sqli_curs_close (mint, ifx_cursor_t *);
+extern void sqli_curs_free (mint, ifx_cursor_t *);
+extern void sqli_connect_open (mint, mint, const char *, char *, ifx_conn_t *, mint);
+extern void sqli_connect_set (mint, char *, mint);
+extern void sqli_connect_close (mint, char *, mint, mint);
+extern void sqli_trans_begin2 (mint);
+extern void sqli_trans_commit (void);
+extern void sqli_trans_rollback (void);
+extern void *ifx_alloc_conn_user (const char *, const char *);
+extern void ifx_free_conn_user (ifx_conn_t **);
+
+extern mlong rtypalign (mlong, mint);
+extern mint rtypmsize (mint, mint);
+extern mint deccvasc (char *, mint, dec_t *);
+extern mint dectoasc (dec_t *, char *, mint, mint);
+extern mint dectodbl (dec_t *, double *);
+extern mint ifx_int8cvasc (char *, mint, ifx_int8_t *);
+extern mint ifx_int8toasc (ifx_int8_t *, char *, mint);
+extern mint bigintcvifx_int8 (const ifx_int8_t *, bigint *);
+extern mint rfmtdate (int4, const char *, char *);
+extern mint rdefmtdate (int4 *, char *, char *);
+extern mint rstrdate (char *, int4 *);
+extern mint rdatestr (int4, char *);
+extern mint dttoasc (dtime_t *, char *);
+extern mint intoasc (intrvl_t *, char *);
+extern mint dtextend (dtime_t *, dtime_t *);
+extern mint invextend (intrvl_t *, intrvl_t *);
+extern mint sqlbreak (void);
+extern mint sqlbreakcallback (int4, void (*)(mint));
+extern mint ifx_lo_open (ifx_lo_t *, mint, mint *);
+extern mint ifx_lo_read (mint, char *, mint, mint *);
+extern mint ifx_lo_close (mint);
+extern mint ifx_lo_stat (mint, ifx_lo_stat_t **);
+extern mint ifx_lo_stat_size (ifx_lo_stat_t *, ifx_int8_t *);
+extern mint ifx_lo_stat_free (ifx_lo_stat_t *);
+
+#endif
@@ -0,0 +1,5 @@
+/*
+** Entry points of the mock ESQL/C runtime, declared with the
+** structures in sqlhdr.h.
+*/
+#include "sqlhdr.h"
@@ -0,0 +1,80 @@
+/*
+** Type codes of the mock ESQL/C runtime, see mock.c.
+** Described columns carry the C type codes the driver decodes, so
+** toctype leaves them alone.
+*/
+#ifndef MOCK_SQLTYPES_H
+#define MOCK_SQLTYPES_H
+
+#define SQLCHAR			0
+#define SQLSMINT		1
+#define SQLINT			2
+#define SQLFLOAT		3
+#define SQLSMFLOAT		4
+#define SQLDECIMAL		5
+#define SQLSERIAL		6
+#define SQLDATE			7
+#define SQLMONEY		8
+#define SQLNULL			9
+#define SQLDTIME		10
+#define SQLBYTES		11
+#define SQLTEXT			12
+#define SQLVCHAR		13
+#define SQLINTERVAL		14
+#define SQLNCHAR		15
+#define SQLNVCHAR		16
+#define SQLINT8			17
+#define SQLSERIAL8		18
+#define SQLSET			19
+#define SQLMULTISET		20
+#define SQLLIST			21
+#define SQLROW			22
+#define SQLCOLLECTION	23
+#define SQLUDTVAR		40
+#define SQLUDTFIXED		41
+#define SQLREFSER8		42
+#define SQLLVARCHAR		43
+#define SQLSENDRECV		44
+#define SQLBOOL			45
+#define SQLIMPEXP		46
+#define SQLIMPEXPBIN	47
+#define SQLINFXBIGINT	52
+#define SQLBIGSERIAL	53
+#define SQLTYPE			0xFF
+
+#define CCHARTYPE		100
+#define CSHORTTYPE		101
+#define CINTTYPE		102
+#define CLONGTYPE		103
+#define CFLOATTYPE		104
+#define CDOUBLETYPE		105
+#define CDECIMALTYPE	107
+#define CFIXCHARTYPE	108
+#define CSTRINGTYPE		109
+#define CDATETYPE		110
+#define CMONEYTYPE		111
+#define CDTIMETYPE		112
+#define CLOCATORTYPE	113
+#define CVCHARTYPE		114
+#define CINVTYPE		115
+#define CFILETYPE		116
+#define CINT8TYPE		117
+#define CCOLLTYPE		118
+#define CLVCHARTYPE		119
+#define CFIXBINTYPE		120
+#define CVARBINTYPE		121
+#define CBOOLTYPE		122
+#define CROWTYPE		123
+#define CLVCHARPTRTYPE	124
+#define CBIGINTTYPE		125
+
+#define XID_LVARCHAR	1
+#define XID_BOOLEAN		5
+#define XID_BLOB		10
+#define XID_CLOB		11
+
+#define ISUDTTYPE(t)		((t) == SQLUDTVAR || (t) == SQLUDTFIXED)
+#define ISCOMPLEXTYPE(t)	((t) >= SQLSET && (t) <= SQLCOLLECTION)
+#define toctype(s, c)		((c) = (s))
+
+#endif
@@ -0,0 +1,191 @@
+--[[
+Fetch benchmark of the driver over the mock ESQL/C runtime of
+bench/esql, no database server needed. "make bench" builds the driver
+against the mock and runs it.
+
+Reports rows/s and ns/cell of the fetch paths (cur:fetch, the iterator,
+'n' and 'a' row tables, fetchmany) over a mixed row, a 100-column row
+and a 1-column row, of the decoder of each column type, and of row
+width and NULL density. With "paths" only the fetch paths are run;
+"make bench" runs them again over a NO_FETCH_STATS build, the
+difference is the cost of the fetch statistics of conn:stats().
+
+usage: lua bench/fetch.lua [rows] [paths]
+]]
+
+local luasql = require "luasql.informix"
+
+local ROWS, PATHS = 200000, false
+for _, a in ipairs(arg or {}) do
+	if a == "paths" then
+		PATHS = true
+	else
+		ROWS = tonumber(a) or ROWS
+	end
+end
+local MIXED = "integer,varchar(32),decimal(16,2),date,float,char(10),bigint,datetime"
+local WIDE = "integer*25,varchar(32)*25,decimal(16,2)*25,date*25"
+
+local env = assert(luasql.informix("mock"))
+local conn = assert(env:connect("bench"))
+
+-- Open a cursor over ROWS synthesized rows of the columns.
+local function query(cols, extra)
+	return assert(conn:execute(string.format("mock rows=%d cols=%s %s", ROWS, cols, extra or "")))
+end
+
+local function count(cols)
+	local n = 1
+	for k in string.gmatch(cols, "%*(%d+)") do
+		n = n + tonumber(k) - 1
+	end
+	for _ in string.gmatch(cols, ",") do
+		n = n + 1
+	end
+	for _ in string.gmatch(cols, "%(%d+,%d+%)") do
+		n = n - 1
+	end
+	return n
+end
+
+-- Time read(cur) over a query of the columns, which reads it to the end.
+local function bench(name, cols, read, extra)
+	local cur = query(cols, extra)
+	collectgarbage()
+	local start = os.clock()
+	local rows = read(cur)
+	local t = os.clock() - start
+	assert(rows == ROWS, name .. ": short read")
+	print(string.format("%-32s %12.0f %10.1f", name, rows / t, t * 1e9 / (rows * count(cols))))
+end
+
+-- Readers: each returns the number of rows read. values and iterator
+-- stop at a NULL first column, the rows they read have no NULLs.
+local function values(cur)
+	local n = 0
+	while cur:fetch() ~= nil do
+		n = n + 1
+	end
+	return n
+end
+
+local function rowtable(mode)
+	return function(cur)
+		local n, row = 0, {}
+		while cur:fetch(row, mode) do
+			n = n + 1
+		end
+		return n
+	end
+end
+
+local function iterator(cur)
+	local n = 0
+	for _ in cur:iterator() do
+		n = n + 1
+	end
+	return n
+end
+
+local function iterator_table(cur)
+	local n = 0
+	for _ in cur:iterator({}, "a") do
+		n = n + 1
+	end
+	return n
+end
+
+local function many(cur)
+	local n = 0
+	repeat
+		local rows = cur:fetchmany(1000)
+		n = n + #rows
+	until #rows < 1000
+	return n
+end
+
+-- Decode the cells with the conversion options set on the cursor.
+local function with(options, read)
+	return function(cur)
+		for k, v in pairs(options) do
+			cur:setoption(k, v)
+		end
+		return read(cur)
+	end
+end
+
+-- Whether the driver was built with the fetch statistics.
+local function timed()
+	local cur = query("integer")
+	cur:fetch()
+	cur:close()
+	return conn:stats().fetch.count > 0
+end
+
+print(string.format("%d rows, fetch statistics %s", ROWS, timed() and "on" or "off"))
+print(string.format("%-32s %12s %10s", "", "rows/s", "ns/cell"))
+
+print("-- fetch paths, " .. MIXED)
+bench("fetch values", MIXED, values)
+bench("fetch 'n'", MIXED, rowtable("n"))
+bench("fetch 'a'", MIXED, rowtable("a"))
+bench("iterator", MIXED, iterator)
+bench("iterator 'a'", MIXED, iterator_table)
+bench("fetchmany 1000", MIXED, many)
+
+print("-- fetch paths, 100 columns")
+bench("wide fetch values", WIDE, values)
+bench("wide fetch 'n'", WIDE, rowtable("n"))
+bench("wide fetch 'a'", WIDE, rowtable("a"))
+bench("wide fetchmany 1000", WIDE, many)
+
+-- one cell per row, where the cost per fetch call shows most
+print("-- fetch paths, 1 column")
+bench("narrow fetch values", "integer", values)
+bench("narrow fetchmany 1000", "integer", many)
+
+if PATHS then
+	conn:close()
+	env:close()
+	return
+end
+
+print("-- column types, 8 columns")
+local types = {
+	{"smallint"}, {"integer"}, {"bigint"}, {"int8"}, {"smallfloat"}, {"float"},
+	{"decimal(16,2)"},
+	{"decimal(16,2)", {decimal = "string"}, "string"},
+	{"decimal(16,2)", {decimal = "scaled"}, "scaled"},
+	{"decimal(32,10)"},
+	{"money(16,2)"},
+	{"char(20)"},
+	{"char(20)", {trim = false}, "no trim"},
+	{"char(200)"},
+	{"varchar(40)"},
+	{"date"},
+	{"date", {temporal = "number"}, "number"},
+	{"datetime"},
+	{"datetime", {temporal = "number"}, "number"},
+	{"time"},
+	{"interval"},
+	{"interval", {temporal = "number"}, "number"},
+	{"interval_ym", {temporal = "number"}, "number"},
+	{"boolean"},
+}
+for _, t in ipairs(types) do
+	local name = t[3] and (t[1] .. " " .. t[3]) or t[1]
+	bench(name, t[1] .. "*8", t[2] and with(t[2], values) or values)
+end
+
+print("-- row width, integer")
+for _, width in ipairs{1, 4, 16, 64, 256} do
+	bench("integer*" .. width, "integer*" .. width, values)
+end
+
+print("-- NULL density, " .. MIXED)
+for _, nulls in ipairs{0.1, 0.5, 0.9} do
+	bench("null=" .. nulls, MIXED, rowtable("n"), "null=" .. nulls)
+end
+
+conn:close()
+env:close()
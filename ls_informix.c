@@ -1,9 +1,24 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#ifdef IFX_THREAD
+#include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RTRIM_X86					/* SSE2/AVX2 trim kernels */
+#endif
 
 #include <sqlhdr.h>
 #include <sqliapi.h>
@@ -17,18 +32,159 @@
 #define LUASQL_ENVIRONMENT_INFORMIX "INFORMIX environment"
 #define LUASQL_CONNECTION_INFORMIX "INFORMIX connection"
 #define LUASQL_CURSOR_INFORMIX "INFORMIX cursor"
+#define LUASQL_STATEMENT_INFORMIX "INFORMIX statement"
+#define LUASQL_LOB_INFORMIX "INFORMIX lob"
+#define LUASQL_POOL_INFORMIX "INFORMIX pool"
+#define LUASQL_ASYNC_INFORMIX "INFORMIX async"
+#define LUASQL_REPLAY_INFORMIX "INFORMIX replay"
 
 #define ENV_INFORMIX_SVR "INFORMIXSERVER"
 #define MAX_NAME_LENGTH  128
+#define STMT_CACHE_SIZE  64			/* default prepared statement cache size */
+#define LOAD_READ_SIZE   (1024*1024)	/* read buffer size of conn:load */
+#define LOAD_BATCH_SIZE  1000		/* rows per insert cursor flush of conn:load */
+#define LOB_CHUNK_SIZE   (64*1024)	/* default read size of large object handles */
+#define ARENA_POOL_SIZE  16			/* free cursor arenas kept per connection */
+#define UDT_TEXT_SIZE    2048		/* text length of UDTs of unknown size */
+#define POOL_MAX_SIZE    10			/* default max connections of a pool */
+#define POOL_IDLE_TIMEOUT 60		/* default seconds a pooled connection stays idle */
+#define POOL_PING_SQL    "select 1 from systables where tabid = 1"
+#define CURS_HOLD        4096		/* sqli_curs_decl_dynm flags: WITH HOLD */
+#define CURS_SCROLL      32			/* SCROLL */
+#define BREAK_TICK_MS    100		/* interval of sqlbreakcallback checks */
+#define SQL_INTERRUPTED  (-213)		/* statement interrupted by sqlbreak */
+#define SLOWLOG_SIZE     128		/* statements kept by the slow log, power of 2 */
+#define SLOWLOG_SQL_SIZE 512		/* SQL text kept per slow statement */
+#define SLOW_THRESHOLD   1.0		/* default seconds of a slow statement */
+#define RESULT_BUCKETS   256		/* hash buckets of the result cache */
+#define RESULT_TTL       60			/* default seconds a cached result lives */
+#define RESULT_TABLES_SIZE 512		/* names of the tables a cached query reads */
+
+/*
+** Counters of a connection, rolled up per environment.
+** Latencies are kept in log2 buckets of microseconds: hist[0] < 1us,
+** hist[b] in [2^(b-1), 2^b) us, the last bucket takes the rest.
+** A fetch is one fetch call, whatever the rows it returns.
+*/
+#define STAT_PREPARE	0
+#define STAT_DESCRIBE	1
+#define STAT_OPEN		2
+#define STAT_FETCH		3
+#define STAT_EXECUTE	4
+#define STAT_COMMIT		5
+#define STAT_ROLLBACK	6
+#define NSTATS			7
+#define HIST_BUCKETS	24
+
+typedef struct {
+	long	count;
+	double	time, max;			/* seconds */
+	long	hist[HIST_BUCKETS];
+} op_stats;
+
+typedef struct {
+	op_stats ops[NSTATS];
+	long	rows;				/* rows fetched */
+	double	bytes_decoded;		/* approximate memory of pushed values */
+	double	buffer_bytes;		/* cursor arenas allocated */
+	long	result_hits, result_misses;	/* queries looked up in the result cache */
+	long	timeouts, cancels;	/* calls broken by the timeout or conn:cancel */
+} conn_stats;
+
+/*
+** Query result kept by the result cache of an environment, see
+** env:setcache. Its rows are the fetch buffer contents, one cell per
+** column: a tag byte (nil, fixed size, short or long string) then the
+** raw bytes, trailing blanks of CHAR values cut. They are decoded when
+** read, with the fetch options of the reading cursor.
+*/
+typedef struct result_entry {
+	struct result_entry *hnext;			/* next entry in the same hash bucket */
+	struct result_entry *prev, *next;	/* LRU list, or captures list while filled */
+	struct result_cache *cache;			/* NULL once the cache is freed */
+	int		cached;						/* linked in the cache */
+	int		stale;						/* a table it reads was written while filled */
+	int		refs;						/* cursors reading or filling it */
+	unsigned int hash;
+	size_t	key_len;
+	char	*key;						/* database, SQL text and parameters */
+	char	*tables;					/* names of the tables read, each NUL ended, then "" */
+	ifx_sqlda_t sqlda;					/* described columns, names in the entry */
+	char	*rows;						/* cells of the rows */
+	size_t	len, cap;
+	long	nrows;
+	size_t	head_size, size;			/* memory held, without and with the rows */
+	double	ttl, expires;
+} result_entry;
+
+typedef struct result_cache {
+	size_t	max_bytes;			/* 0 disables the cache */
+	size_t	max_entry;			/* bytes of the largest result kept */
+	double	ttl;				/* default seconds an entry lives */
+	size_t	bytes;
+	int		count;
+	result_entry **buckets;		/* RESULT_BUCKETS, NULL until enabled */
+	result_entry *head, *tail;	/* LRU list, most recently used first */
+	result_entry *capturing;	/* entries being filled by their cursors */
+	long	hits, misses, stores, evictions, expirations, invalidations, bypasses;
+} result_cache;
 
 typedef struct {
 	short	closed;
-	char	*old_env;			/* point to env str in u area */
-	char	curr_env[MAX_NAME_LENGTH+32];	/* string to set env */
+	char	server[MAX_NAME_LENGTH];	/* database server, empty for $INFORMIXSERVER */
 	int		conn_cnt;			/* total connection count */
+	conn_stats	closed_stats;	/* of its closed connections */
+	result_cache	cache;		/* query results, see env:setcache */
 } env_data;
 
+/*
+** Value conversions of fetched columns, set by setoption.
+*/
+#define DEC_NUMBER	0			/* DECIMAL/MONEY as a Lua number */
+#define DEC_STRING	1			/* exact decimal text */
+#define DEC_SCALED	2			/* {integer mantissa, scale} pair */
+
+typedef struct {
+	int		decimal;			/* DEC_NUMBER, DEC_STRING or DEC_SCALED */
+	int		trim;				/* strip trailing blanks of strings */
+	int		temporal;			/* DATE/DATETIME/INTERVAL as numbers */
+	int		lob;				/* BLOB/CLOB as lob handles */
+} fetch_opts;
+
+/*
+** Prepared statement, keyed by its SQL text in the statement cache.
+*/
+typedef struct stmt_entry {
+	struct stmt_entry *hnext;			/* next entry in the same hash bucket */
+	struct stmt_entry *prev, *next;		/* LRU list, most recently used first */
+	int		cached;						/* linked in the statement cache */
+	int		keep;						/* owned by a statement object */
+	unsigned int hash;
+	size_t	sql_len;
+	char	*sql;
+	ifx_cursor_t *stmt;					/* prepared statement */
+	ifx_sqlda_t *sqlda;					/* described columns, NULL if not a query */
+	int		colnames, coltypes;			/* reference to column information tables */
+} stmt_entry;
+
 typedef struct {
+	int		size;				/* max entries, 0 disables the cache */
+	int		count;
+	int		nbuckets;
+	stmt_entry **buckets;
+	stmt_entry *head, *tail;
+	long	hits, misses, evictions;
+} stmt_cache;
+
+/*
+** Free cursor arena, linked in the pool of its connection.
+*/
+typedef struct arena_blk {
+	struct arena_blk *next;
+	size_t	size;
+} arena_blk;
+
+typedef struct conn_data {
 	short	closed;
 	int		env;                /* reference to environment */
 	char	conn_name[MAX_NAME_LENGTH];
@@ -36,17 +192,176 @@ typedef struct {
 	int		auto_commit;
 	int		auto_begin;
 	ifx_sqlca_t	conn_sqlca;
+	stmt_cache	cache;			/* prepared statement cache */
+	fetch_opts	opts;			/* fetch options of new cursors */
+	arena_blk	*arenas;		/* free cursor arenas, most recent first */
+	int		narenas;
+	long	switches;			/* sqli_connect_set calls made */
+	long	switches_skipped;	/* set_conn calls on the current connection */
+	long	lookups_skipped;	/* cursor name lookups saved by cur_data.curs */
+	int		pool;				/* reference to its pool, LUA_NOREF if not pooled */
+	int		pool_idle;			/* released to its pool */
+	double	idle_since;
+	struct async_data *async;	/* call running in a worker, NULL if none */
+	double	timeout;			/* seconds per call, 0 for none */
+	double	deadline;			/* end of the running call, 0 for none */
+	volatile sig_atomic_t cancel;	/* set by conn:cancel */
+	const char *broken;			/* why the running call was interrupted */
+	struct conn_data *list_next;	/* open connections of the process */
+	env_data	*envp;
+	conn_stats	stats;
+	conn_stats	*timing;		/* where calls are timed: stats, or those of an async call */
+	int		hook;				/* reference to the query hook */
+	double	slow;				/* seconds from which statements are logged */
+	FILE	*trace;				/* trace file of conn:settrace, NULL if none */
+	double	trace_start;
+	unsigned int trace_ids;		/* cursors traced */
+	int		trace_failed;		/* a write to the trace file failed */
+	char	dbkey[MAX_NAME_LENGTH*3];	/* database and user, scoping cached results */
+	int		written;			/* reference to the set of tables written in the
+								   open transaction, LUA_NOREF if none */
+	unsigned int generation;	/* bumped when released to its pool */
 } conn_data;
 
+/*
+** Connection pool of an environment. Released connections are kept in
+** the idle table, least recently released first.
+*/
+typedef struct {
+	short	closed;
+	int		env;				/* reference to environment */
+	int		login;				/* reference to {db, user, password} */
+	int		idle;				/* reference to the table of idle connections */
+	int		nidle;
+	int		busy;				/* connections checked out */
+	int		min, max;
+	double	idle_timeout;		/* seconds, <= 0 keeps idle connections */
+	long	acquires, waits, timeouts;
+	long	opened, closed_cnt, failed_checks;
+	double	wait_time, max_wait;
+} pool_data;
+
+/*
+** Cursor recorded in a trace file, see conn:replay. Points into the
+** file contents held by its replay.
+*/
 typedef struct {
+	struct replay_data *rep;
+	unsigned int id;
+	double	ts;					/* seconds from the start of the trace */
+	const char *sql;
+	size_t	sql_len;
+	int		sqld;
+	size_t	buflen;				/* bytes of the fetch buffer */
+	const char *cols;			/* column descriptions */
+	int		has_loc;			/* has locator columns */
+	long	nrows;
+	const char **rows;			/* row records in fetch order */
+	int		endcode;			/* sqlcode after the last row */
+} trace_cursor;
+
+typedef struct replay_data {
+	short	closed;
+	int		conn;				/* reference to connection */
+	char	*data;				/* contents of the trace file */
+	size_t	size;
+	trace_cursor *cursors;		/* in the order they were opened */
+	const char **rows;			/* row records of all cursors */
+	int		ncursors;
+	int		next;				/* next cursor to replay */
+	int		open;				/* replayed cursors not closed */
+	int		timed;				/* wait for the recorded times */
+	double	start;
+} replay_data;
+
+typedef struct cur_data cur_data;
+
+/*
+** Push the (not NULL) value of a fetched column.
+*/
+typedef void (*col_decoder) (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar);
+
+struct cur_data {
 	short	closed;
 	int		conn;               /* reference to connection */
 	int		colnames, coltypes; /* reference to column information tables */
 	char	cur_name[MAX_NAME_LENGTH];
+	ifx_cursor_t *curs;			/* resolved at open */
+	char	*arena;				/* single allocation holding the four below */
+	size_t	arena_size;
 	ifx_sqlda_t *cur_sqlda;
 	char	*buf;				/* buffer to put fetch data */
 	int2	*indicators;		/* buffer for the indicators */
-} cur_data;
+	col_decoder *decoders;		/* decoder of each column, chosen at open */
+	fetch_opts	opts;
+	int		scroll;				/* declared SCROLL */
+	int		sql;				/* reference to the SQL text, for query events */
+	double	started;
+	long	rows;				/* rows fetched */
+	int		sqlcode;			/* of the last fetch */
+	unsigned int trace_id;		/* in the trace of its connection, 0 if not traced */
+	trace_cursor *replay;		/* recorded cursor replayed, NULL for a server cursor */
+	int		replay_obj;			/* reference to the replay object */
+	long	replay_pos;			/* rows replayed */
+	result_entry *capture;		/* cached result filled by its rows, NULL if none */
+	result_entry *result;		/* cached result read, NULL for a server cursor */
+	const char *result_pos;		/* cells of the next row */
+	long	result_left;		/* rows not read yet */
+	unsigned int generation;	/* of its connection when created */
+};
+
+/*
+** Smart large object fetched as a handle.
+*/
+typedef struct {
+	short	closed;
+	int		conn;               /* reference to connection */
+	ifx_lo_t lo;
+	mint	fd;					/* open descriptor, -1 until the first read */
+	char	*buf;				/* read buffer */
+	int		bufsize;
+} lob_data;
+
+/*
+** Lua function feeding a large object parameter through a LOCUSER
+** locator, one returned string at a time.
+*/
+typedef struct {
+	lua_State *L;
+	int		fn;					/* stack index of the function */
+	int		chunk;				/* reference to the pending chunk */
+	size_t	off;				/* bytes of the pending chunk already sent */
+	int		err;				/* reference to the error of the function */
+} lob_reader;
+
+/*
+** Input parameter of a prepared statement.
+*/
+typedef struct {
+	int2	type;				/* described sql type */
+	int4	xid;				/* described extended type id */
+	union {
+		int4	i;
+		bigint	b;
+		double	d;
+		char	c;
+		dec_t	dec;
+		struct {
+			ifx_loc_t loc;
+			lob_reader rd;
+		} lob;
+	} value;					/* storage for non-string values */
+} bind_param;
+
+typedef struct {
+	short	closed;
+	int		conn;               /* reference to connection */
+	stmt_entry *entry;			/* prepared statement, not cached */
+	ifx_sqlda_t *in_sqlda;		/* described input parameters, NULL if none */
+	bind_param *params;
+	int2	*in_ind;			/* indicators of input parameters */
+	unsigned int generation;	/* of its connection when created */
+} stmt_data;
 
 LUASQL_API int luaopen_luasql_informix (lua_State *L);
 
@@ -72,6 +387,21 @@ static conn_data *getconnection (lua_State *L) {
 }
 
 
+/*
+** Check that the connection referenced by ref was not released to its
+** pool since the cursor or statement was created; it may be checked out
+** by another user now.
+*/
+static void checkgeneration (lua_State *L, int ref, unsigned int generation) {
+	conn_data *conn;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+	conn = (conn_data *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	luaL_argcheck(L, conn->generation == generation, 1, "connection was released to its pool");
+}
+
+
 /*
 ** Check for valid cursor.
 */
@@ -79,9 +409,21 @@ static cur_data *getcursor (lua_State *L) {
 	cur_data *cur = (cur_data *)luaL_checkudata(L, 1, LUASQL_CURSOR_INFORMIX);
 	luaL_argcheck(L, cur != NULL, 1, "cursor expected");
 	luaL_argcheck(L, !cur->closed, 1, "cursor is closed");
+	checkgeneration(L, cur->conn, cur->generation);
 	return cur;
 }
 
+/*
+** Check for valid statement.
+*/
+static stmt_data *getstatement (lua_State *L) {
+	stmt_data *stmt = (stmt_data *)luaL_checkudata(L, 1, LUASQL_STATEMENT_INFORMIX);
+	luaL_argcheck(L, stmt != NULL, 1, "statement expected");
+	luaL_argcheck(L, !stmt->closed, 1, "statement is closed");
+	checkgeneration(L, stmt->conn, stmt->generation);
+	return stmt;
+}
+
 /*
 ** Get conn data from ref
 */
@@ -107,677 +449,5848 @@ static env_data *getenvfromref (lua_State *L, int ref) {
 
 
 /*
-** switch env 
+** Get pool data from ref
 */
-inline static int set_env (env_data *env) {
-	if (strlen(env->curr_env) != 0) {
-		return putenv(env->curr_env);
+static pool_data *getpoolfromref (lua_State *L, int ref) {
+	pool_data *pool = NULL;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+	pool = (pool_data *)luaL_checkudata(L, -1, LUASQL_POOL_INFORMIX);
+	lua_pop(L, 1);
+	return pool;
+}
+
+
+/*
+** Seconds from a monotonic clock.
+*/
+static double now_seconds (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+** Count an operation started at start.
+*/
+static void stat_time (conn_stats *stats, int op, double start) {
+	op_stats *p = &(stats->ops[op]);
+	double t = now_seconds() - start;
+	unsigned long us = (unsigned long)(t * 1e6);
+	int b = 0;
+
+	while ((us != 0) && (b < HIST_BUCKETS - 1)) {
+		us >>= 1;
+		b++;
 	}
-	return 0;
+	p->count++;
+	p->time += t;
+	if (t > p->max)
+		p->max = t;
+	p->hist[b]++;
 }
 
-inline static int restore_env (env_data *env) {
-	if ((env->old_env != NULL)&&(strlen(env->curr_env)) != 0) {
-		return putenv(env->old_env);
+/*
+** Time a fetch call and count the bytes of the values it pushed.
+** NO_FETCH_STATS builds leave this out, to measure what it costs.
+*/
+#ifndef NO_FETCH_STATS
+#define FETCH_CLOCK()					now_seconds()
+#define FETCH_DONE(conn, start, bytes)	do { \
+		stat_time(&((conn)->stats), STAT_FETCH, (start)); \
+		(conn)->stats.bytes_decoded += (bytes); \
+	} while (0)
+#else
+#define FETCH_CLOCK()					0.0
+#define FETCH_DONE(conn, start, bytes)	((void)(start), (void)(bytes))
+#endif
+
+
+static void stats_add (conn_stats *dst, const conn_stats *src) {
+	int i, b;
+
+	for (i = 0; i < NSTATS; i++) {
+		dst->ops[i].count += src->ops[i].count;
+		dst->ops[i].time += src->ops[i].time;
+		if (src->ops[i].max > dst->ops[i].max)
+			dst->ops[i].max = src->ops[i].max;
+		for (b = 0; b < HIST_BUCKETS; b++)
+			dst->ops[i].hist[b] += src->ops[i].hist[b];
 	}
-	return 0;
+	dst->rows += src->rows;
+	dst->bytes_decoded += src->bytes_decoded;
+	dst->buffer_bytes += src->buffer_bytes;
+	dst->result_hits += src->result_hits;
+	dst->result_misses += src->result_misses;
+	dst->timeouts += src->timeouts;
+	dst->cancels += src->cancels;
 }
 
 
+/*
+** Current ESQL/C connection, NULL if unknown.
+** ESQL/C keeps one per thread in thread-safe builds (IFX_THREAD), where
+** sqlca is per thread as well.
+*/
+#ifdef IFX_THREAD
+static __thread conn_data *active_conn = NULL;
+#else
+static conn_data *active_conn = NULL;
+#endif
+
+
 /*
 ** switch connection
 */
 inline static void set_conn (lua_State *L, conn_data *conn) {
+	if (conn->async != NULL)
+		luaL_error(L, LUASQL_PREFIX"connection is busy with an asynchronous call");
+	/* arm the timeout of the call */
+	conn->cancel = 0;
+	conn->broken = NULL;
+	conn->deadline = (conn->timeout > 0) ? now_seconds() + conn->timeout : 0;
+	if (conn == active_conn) {
+		conn->switches_skipped++;
+		return;
+	}
 	sqli_connect_set(0, conn->conn_name, 0);
+	conn->switches++;
+	active_conn = (sqlca.sqlcode == 0) ? conn : NULL;
 }
 
 
 /*
-** Push the value of #i field of #tuple row.
+** Open connections of the process, for luasql.cancel from other threads.
 */
-static void pushvalue (lua_State *L, int2 *ind, int type, char *data, long len) {
-	int i;
-	char str_num[64];
-	char c_data;
-	long l_data;
-	double d_data;
+static conn_data *conn_list = NULL;
+#ifdef IFX_THREAD
+static pthread_mutex_t conn_list_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CONN_LIST()	pthread_mutex_lock(&conn_list_lock)
+#define UNLOCK_CONN_LIST()	pthread_mutex_unlock(&conn_list_lock)
+#else
+#define LOCK_CONN_LIST()
+#define UNLOCK_CONN_LIST()
+#endif
 
-	if (*ind == -1) {
-		lua_pushnil(L);
+
+/*
+** Called by ESQL/C while the server works on a request of the current
+** connection, every BREAK_TICK_MS with status 2. Interrupts the request
+** when it is cancelled or past its deadline; it then fails with
+** SQL_INTERRUPTED.
+*/
+static void break_callback (mint status) {
+	conn_data *conn = active_conn;
+
+	if ((status != 2) || (conn == NULL) || (conn->broken != NULL))
 		return;
+	if (conn->cancel) {
+		conn->broken = "statement cancelled";
+		conn->timing->cancels++;
 	}
-	memset(str_num,0,sizeof(str_num));
-	switch(type) {
-		case CCHARTYPE:
-		case CVCHARTYPE:
-		case CSTRINGTYPE:
-			i=stleng(data);
-			while (((data[i - 1] == '\0') || (data[i - 1] == ' ')) && (i > 0)) i--;
-			data[i] = '\0';
-			lua_pushstring(L, data);
-			return;
-		case CSHORTTYPE:
-			l_data = (long) (*((short *)data));
-			lua_pushinteger(L, l_data);
-			return;
-		case CINTTYPE:
-			l_data = (long) (*((int *)data));
-			lua_pushinteger(L, l_data);
-			return;
-		case CLONGTYPE:
-		case CBIGINTTYPE:
-			l_data = *((long *)data);
-			lua_pushinteger(L, l_data);
-			return;
-		case CFLOATTYPE:
-			d_data = (double) (*((float *)data));
-			lua_pushnumber(L, d_data);
-			return;
-		case CDOUBLETYPE:
-			d_data = (*((double *)data));
-			lua_pushnumber(L, d_data);
-			return;
-		case CINT8TYPE:
-			if (ifx_int8toasc((ifx_int8_t *)data, str_num, sizeof(str_num)-1) == 0) {
-				l_data=atol(str_num);
-				lua_pushinteger(L, l_data);
-			}
-			else
-				lua_pushnil(L);
-			return;
-		case CDECIMALTYPE:
-		case CMONEYTYPE:
-			dectoasc((dec_t *)data, str_num, sizeof(str_num)-1, -1);
-			d_data = atof(str_num);
-			lua_pushnumber(L, d_data);
-			return;
-		case CDATETYPE:
-			rfmtdate(*(int *)data, "YYYYMMDD", str_num);
-			lua_pushstring(L, str_num);
-			return;
-		case CDTIMETYPE:
-			dttoasc((dtime_t *)data, str_num);
-			lua_pushstring(L, str_num);
-			return;
-		case CINVTYPE:
-			intoasc((intrvl_t *)data, str_num);
-			lua_pushstring(L, str_num);
-			return;
-		case CLOCATORTYPE:
-			{
-				ifx_loc_t *loc = (ifx_loc_t *)data;
-				if (loc->loc_indicator == -1)
-					lua_pushnil(L);
-				else
-					lua_pushlstring(L, loc->loc_buffer, loc->loc_size);
-				return;
-			}
-		case CROWTYPE:
-		case CCOLLTYPE:
-		case CLVCHARTYPE:
-			lua_pushlstring(L, data, len);
-			return;
-		case CBOOLTYPE:
-			c_data = *((char *)data);
-			lua_pushboolean(L, c_data);
-			return;
-		default:
-			lua_pushnil(L);
-			return;
+	else if ((conn->deadline > 0) && (now_seconds() >= conn->deadline)) {
+		conn->broken = "statement timeout";
+		conn->timing->timeouts++;
 	}
+	else
+		return;
+	sqlbreak();
 }
 
 
 /*
-** Push error message from sqlca 
+** Right trim kernels: return the length of s[0..n) without its trailing
+** blanks and NULs. luaopen picks the fastest one the CPU supports.
 */
-static void pusherrmsg (lua_State *L, ifx_sqlca_t *p_sqlca, char *hint) {
-	if (p_sqlca->sqlcode == 0) {
-		lua_pushnil(L);
-	}
-	else {
-		lua_pushfstring(L, "%s fail, CODE:%d ISAM:%d MSG:%s",
-			hint, p_sqlca->sqlcode, p_sqlca->sqlerrd[1], p_sqlca->sqlerrm);
+static size_t rtrim_scalar (const char *s, size_t n) {
+	while ((n > 0) && ((s[n - 1] == ' ') || (s[n - 1] == '\0'))) n--;
+	return n;
+}
+
+/* a byte is a blank or a NUL if it is 0 once bit 0x20 is cleared */
+#define PAD_MASK	(((size_t)~(size_t)0 / 0xff) * 0xdf)
+
+static size_t rtrim_word (const char *s, size_t n) {
+	size_t w;
+
+	while (n >= sizeof(size_t)) {
+		memcpy(&w, s + n - sizeof(size_t), sizeof(size_t));
+		if ((w & PAD_MASK) != 0)
+			break;
+		n -= sizeof(size_t);
 	}
+	return rtrim_scalar(s, n);
 }
 
+#ifdef RTRIM_X86
+__attribute__((target("sse2")))
+static size_t rtrim_sse2 (const char *s, size_t n) {
+	const __m128i mask = _mm_set1_epi8((char)0xdf);
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int m;
+
+	while (n >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + n - 16));
+		m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, mask), zero)) & 0xffff;
+		if (m != 0)
+			return n - 16 + 32 - __builtin_clz(m);
+		n -= 16;
+	}
+	return rtrim_word(s, n);
+}
 
-/*
-** Get the internal database type name of the given column.
-*/
-static char *getcolumntype (int type) {
-	switch (type) {
-		case CCHARTYPE:
-		case CVCHARTYPE:
-		case CSTRINGTYPE:
-			return "string";
-		case CSHORTTYPE:
-		case CINTTYPE:
-		case CBIGINTTYPE:
-		case CINT8TYPE:
-			return "integer";
-		case CFLOATTYPE:
-		case CDOUBLETYPE:
-		case CDECIMALTYPE:
-		case CMONEYTYPE:
-			return "number";
-		case CDATETYPE:
-			return "date";
-		case CDTIMETYPE:
-		case CINVTYPE:
-			return "datetime";
-		case CLOCATORTYPE:
-		case CROWTYPE:
-		case CLVCHARTYPE:
-		case CFIXBINTYPE:
-		case CVARBINTYPE:
-			return "binary";
-		case CCOLLTYPE:
-			return "collection";
-		case CBOOLTYPE:
-			return "boolean";
-		default:
-			return "unknown";
+__attribute__((target("avx2")))
+static size_t rtrim_avx2 (const char *s, size_t n) {
+	const __m256i mask = _mm256_set1_epi8((char)0xdf);
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int m;
+
+	while (n >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+		m = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, mask), zero));
+		if (m != 0)
+			return n - 32 + 32 - __builtin_clz(m);
+		n -= 32;
 	}
+	return rtrim_word(s, n);
 }
+#endif
+
+static size_t (*rtrim) (const char *s, size_t n) = rtrim_word;
 
 
 /*
-** Get the internal database type length
+** Column decoders, one per C type of the fetch buffer.
 */
-static void getcolumntypelen (int type,long len,int *out_len1,int *out_len2) {
-	*out_len1 = -1;
-	*out_len2 = -1;
+static void dec_char (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushlstring(L, sqlvar->sqldata, rtrim(sqlvar->sqldata, sqlvar->sqllen - 1));
+}
 
-	switch (type) {
-		case CCHARTYPE:
-		case CVCHARTYPE:
-		case CSTRINGTYPE:
-			*out_len1 = len - 1;
-			return ;
-		case CSHORTTYPE:
-		case CINTTYPE:
-		case CBIGINTTYPE:
-		case CINT8TYPE:
-			return ;
-		case CFLOATTYPE:
-			*out_len1 = 4;
-			return ;
-		case CDOUBLETYPE:
-			*out_len1 = 8;
-			return ;
-		case CDECIMALTYPE:
-		case CMONEYTYPE:
-			*out_len1 = PRECTOT(len);
-			*out_len2 = PRECDEC(len);
-			return ;
-		case CDATETYPE:
-			return ;
-		case CDTIMETYPE:
-		case CINVTYPE:
-			{
-				*out_len1 = TU_START(len);
-				*out_len2 = TU_END(len);
-				return ;
-			}
-		case CLOCATORTYPE:
-		case CROWTYPE:
-		case CLVCHARTYPE:
-		case CFIXBINTYPE:
-		case CVARBINTYPE:
-			return ;
-		case CCOLLTYPE:
-			return ;
-		case CBOOLTYPE:
-			return ;
-		default:
-			return ;
-	}
+/* blank padded to the column length, no scan needed */
+static void dec_char_raw (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushlstring(L, sqlvar->sqldata, sqlvar->sqllen - 1);
+}
+
+static void dec_string (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char *data = sqlvar->sqldata;
+	lua_pushlstring(L, data, rtrim(data, strlen(data)));
+}
+
+static void dec_string_raw (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushstring(L, sqlvar->sqldata);
+}
+
+static void dec_short (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushinteger(L, *((short *)sqlvar->sqldata));
+}
+
+static void dec_int (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushinteger(L, *((int *)sqlvar->sqldata));
+}
+
+static void dec_long (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushinteger(L, *((long *)sqlvar->sqldata));
+}
+
+static void dec_bigint (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushinteger(L, *((bigint *)sqlvar->sqldata));
+}
+
+static void dec_float (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushnumber(L, *((float *)sqlvar->sqldata));
+}
+
+static void dec_double (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushnumber(L, *((double *)sqlvar->sqldata));
 }
 
 
 /*
-** Creates the lists of fields names and fields types.
+** Powers of 100 that are exact doubles.
 */
-static void create_colinfo (lua_State *L, cur_data *cur) {
+static const double pow100[] = {
+	1e0, 1e2, 1e4, 1e6, 1e8, 1e10, 1e12, 1e14, 1e16, 1e18, 1e20, 1e22
+};
+
+/*
+** Base-100 digit of a decimal at weight 100^pos.
+*/
+inline static int dec_digit (const dec_t *dec, int pos) {
+	int i = dec->dec_exp - 1 - pos;
+	return ((i >= 0) && (i < dec->dec_ndgts)) ? dec->dec_dgts[i] : 0;
+}
+
+/*
+** Convert a decimal to double by walking its base-100 digits.
+** Up to 18 significant digits are summed exactly, so a value with at
+** most 15 significant digits is converted with a single rounding.
+*/
+static double dec_to_double (const dec_t *dec) {
+	int ndgts = dec->dec_ndgts;
+	int scale = dec->dec_exp - ndgts;
+	double d;
+	int i;
+
+	if (ndgts <= 9) {
+		bigint m = 0;
+		for (i = 0; i < ndgts; i++)
+			m = m * 100 + dec->dec_dgts[i];
+		d = (double)m;
+	}
+	else {
+		d = 0;
+		for (i = 0; i < ndgts; i++)
+			d = d * 100 + dec->dec_dgts[i];
+	}
+	while (scale > 11) {
+		d *= pow100[11];
+		scale -= 11;
+	}
+	while (scale < -11) {
+		d /= pow100[11];
+		scale += 11;
+	}
+	d = (scale >= 0) ? d * pow100[scale] : d / pow100[-scale];
+	return (dec->dec_pos == 0) ? -d : d;
+}
+
+/*
+** Fraction digits of a decimal column, -1 for a floating point decimal.
+*/
+inline static int dec_scale (ifx_sqlvar_t *sqlvar) {
+	int scale = PRECDEC(sqlvar->sqllen);
+	return (scale == 255) ? -1 : scale;
+}
+
+/*
+** Write the exact text of a decimal with scale fraction digits, or all
+** significant ones if scale is -1. Return the length of the text.
+*/
+#define DEC_TEXT_SIZE	320
+
+static int dec_to_string (const dec_t *dec, int scale, char *buf) {
+	char *p = buf;
+	int lo = dec->dec_exp - dec->dec_ndgts;	/* lowest base-100 weight */
+	int pos, k, n;
+
+	if ((dec->dec_pos == 0) && (dec->dec_ndgts > 0))
+		*(p++) = '-';
+	if (dec->dec_exp <= 0)
+		*(p++) = '0';
+	for (pos = dec->dec_exp - 1; pos >= 0; pos--) {
+		int d = dec_digit(dec, pos);
+		if ((pos < dec->dec_exp - 1) || (d >= 10))
+			*(p++) = '0' + d / 10;
+		*(p++) = '0' + d % 10;
+	}
+	n = (scale >= 0) ? scale : ((lo < 0) ? -2 * lo : 0);
+	if (n > 0) {
+		*(p++) = '.';
+		for (k = 0; k < n; k++) {
+			int d = dec_digit(dec, -1 - k / 2);
+			*(p++) = '0' + ((k % 2 == 0) ? d / 10 : d % 10);
+		}
+		if (scale < 0) {
+			while (p[-1] == '0') p--;
+			if (p[-1] == '.') p--;
+		}
+	}
+	*p = '\0';
+	return p - buf;
+}
+
+static void dec_decimal (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	dec_t *dec = (dec_t *)sqlvar->sqldata;
+
+	if (dec->dec_pos == DECPOSNULL)
+		lua_pushnil(L);
+	else
+		lua_pushnumber(L, dec_to_double(dec));
+}
+
+static void dec_decimal_string (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	dec_t *dec = (dec_t *)sqlvar->sqldata;
+	char buf[DEC_TEXT_SIZE];
+
+	if (dec->dec_pos == DECPOSNULL)
+		lua_pushnil(L);
+	else
+		lua_pushlstring(L, buf, dec_to_string(dec, dec_scale(sqlvar), buf));
+}
+
+/*
+** Mantissas below this bound are exact Lua numbers.
+*/
+#if LUA_VERSION_NUM >= 503
+#define SCALED_LIMIT	((bigint)1000000000000000000LL)
+#else
+#define SCALED_LIMIT	((bigint)1000000000000000LL)
+#endif
+
+/*
+** Push a decimal as {mantissa, scale}, its value being
+** mantissa / 10^scale. The mantissa is a string of digits when it is
+** too long for a Lua number.
+*/
+static void dec_decimal_scaled (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	dec_t *dec = (dec_t *)sqlvar->sqldata;
+	int scale = dec_scale(sqlvar);
+	int lo = dec->dec_exp - dec->dec_ndgts;
+	int pos, k, exact = 1;
+	bigint m = 0;
+
+	if (dec->dec_pos == DECPOSNULL) {
+		lua_pushnil(L);
+		return;
+	}
+	if (scale < 0)
+		scale = (lo < 0) ? -2 * lo : 0;
+	for (pos = dec->dec_exp - 1; pos >= 0; pos--) {
+		if (m >= SCALED_LIMIT / 100) {
+			exact = 0;
+			break;
+		}
+		m = m * 100 + dec_digit(dec, pos);
+	}
+	for (k = 0; exact && (k < scale); k++) {
+		int d = dec_digit(dec, -1 - k / 2);
+		if (m >= SCALED_LIMIT / 10) {
+			exact = 0;
+			break;
+		}
+		m = m * 10 + ((k % 2 == 0) ? d / 10 : d % 10);
+	}
+	lua_createtable(L, 2, 0);
+	if (exact) {
+		lua_pushinteger(L, (dec->dec_pos == 0) ? -m : m);
+	}
+	else {
+		char buf[DEC_TEXT_SIZE], *p, *q;
+		dec_to_string(dec, scale, buf);
+		for (p = q = buf; *p != '\0'; p++)
+			if (*p != '.')
+				*(q++) = *p;
+		lua_pushlstring(L, buf, q - buf);
+	}
+	lua_rawseti(L, -2, 1);
+	lua_pushinteger(L, scale);
+	lua_rawseti(L, -2, 2);
+}
+
+static void dec_date (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char str_num[64];
+
+	memset(str_num,0,sizeof(str_num));
+	rfmtdate(*(int *)sqlvar->sqldata, "YYYYMMDD", str_num);
+	lua_pushstring(L, str_num);
+}
+
+static void dec_dtime (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char str_num[64];
+
+	memset(str_num,0,sizeof(str_num));
+	dttoasc((dtime_t *)sqlvar->sqldata, str_num);
+	lua_pushstring(L, str_num);
+}
+
+static void dec_intrvl (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	char str_num[64];
+
+	memset(str_num,0,sizeof(str_num));
+	intoasc((intrvl_t *)sqlvar->sqldata, str_num);
+	lua_pushstring(L, str_num);
+}
+
+/*
+** Numeric temporal values. DATE is its day number, DATETIME the
+** seconds since 1970-01-01 00:00:00 (taken as UTC), or since midnight
+** if it has no date part, and INTERVAL its total seconds, or total
+** months for a YEAR TO MONTH interval.
+*/
+static void dec_date_number (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushinteger(L, *((int4 *)sqlvar->sqldata));
+}
+
+/*
+** Days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+*/
+static long days_from_civil (int y, int m, int d) {
+	long era;
+	int yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = ((y >= 0) ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+/*
+** Seconds of an HOUR TO FRACTION(5) part, which lies at base-100
+** weights 2 (hour) to -3.
+*/
+static double dt_seconds (const dec_t *dec) {
+	return dec_digit(dec, 2) * 3600 + dec_digit(dec, 1) * 60 + dec_digit(dec, 0)
+		+ (dec_digit(dec, -1) * 10000 + dec_digit(dec, -2) * 100 + dec_digit(dec, -3)) / 1e6;
+}
+
+static void dec_dtime_number (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	dtime_t *dt = (dtime_t *)sqlvar->sqldata;
+	dtime_t ext;
+	const dec_t *dec = &(ext.dt_dec);
+
+	if (TU_START(dt->dt_qual) > TU_DAY) {
+		ext.dt_qual = TU_DTENCODE(TU_HOUR, TU_F5);
+		if (dtextend(dt, &ext) != 0)
+			lua_pushnil(L);
+		else
+			lua_pushnumber(L, dt_seconds(dec));
+	}
+	else {
+		ext.dt_qual = TU_DTENCODE(TU_YEAR, TU_F5);
+		if (dtextend(dt, &ext) != 0)
+			lua_pushnil(L);
+		else
+			lua_pushnumber(L, days_from_civil(dec_digit(dec, 6) * 100 + dec_digit(dec, 5),
+				dec_digit(dec, 4), dec_digit(dec, 3)) * 86400.0 + dt_seconds(dec));
+	}
+}
+
+static void dec_intrvl_number (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	intrvl_t *in = (intrvl_t *)sqlvar->sqldata;
+	intrvl_t ext;
+	const dec_t *dec = &(ext.in_dec);
+	double lead = 0;
+	int pos;
+
+	if (TU_START(in->in_qual) <= TU_MONTH) {
+		ext.in_qual = TU_IENCODE(9, TU_YEAR, TU_MONTH);
+		if (invextend(in, &ext) != 0) {
+			lua_pushnil(L);
+			return;
+		}
+		for (pos = dec->dec_exp - 1; pos >= 1; pos--)
+			lead = lead * 100 + dec_digit(dec, pos);
+		lead = lead * 12 + dec_digit(dec, 0);
+		lua_pushinteger(L, (lua_Integer)((dec->dec_pos == 0) ? -lead : lead));
+	}
+	else {
+		ext.in_qual = TU_IENCODE(9, TU_DAY, TU_F5);
+		if (invextend(in, &ext) != 0) {
+			lua_pushnil(L);
+			return;
+		}
+		for (pos = dec->dec_exp - 1; pos >= 3; pos--)
+			lead = lead * 100 + dec_digit(dec, pos);
+		lead = lead * 86400 + dt_seconds(dec);
+		lua_pushnumber(L, (dec->dec_pos == 0) ? -lead : lead);
+	}
+}
+
+static void dec_locator (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+
+	if (loc->loc_indicator == -1)
+		lua_pushnil(L);
+	else
+		lua_pushlstring(L, loc->loc_buffer, loc->loc_size);
+}
+
+static void dec_lob (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lob_data *lob = (lob_data *)lua_newuserdata(L, sizeof(lob_data));
+	luasql_setmeta(L, LUASQL_LOB_INFORMIX);
+
+	lob->closed = 0;
+	lob->fd = -1;
+	lob->buf = NULL;
+	lob->bufsize = 0;
+	memcpy(&(lob->lo), sqlvar->sqldata, sizeof(ifx_lo_t));
+	lua_rawgeti(L, LUA_REGISTRYINDEX, cur->conn);
+	lob->conn = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+static void dec_binary (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushlstring(L, sqlvar->sqldata, sqlvar->sqllen);
+}
+
+static void dec_bool (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushboolean(L, *((char *)sqlvar->sqldata));
+}
+
+static void dec_unknown (lua_State *L, cur_data *cur, ifx_sqlvar_t *sqlvar) {
+	lua_pushnil(L);
+}
+
+
+/*
+** Choose the decoder of a C type.
+*/
+static col_decoder getdecoder (int type, const fetch_opts *opts) {
+	switch(type) {
+		case CCHARTYPE:
+			return opts->trim ? dec_char : dec_char_raw;
+		case CVCHARTYPE:
+		case CSTRINGTYPE:
+			return opts->trim ? dec_string : dec_string_raw;
+		case CSHORTTYPE:
+			return dec_short;
+		case CINTTYPE:
+			return dec_int;
+		case CLONGTYPE:
+			return dec_long;
+		case CBIGINTTYPE:
+			return dec_bigint;
+		case CFLOATTYPE:
+			return dec_float;
+		case CDOUBLETYPE:
+			return dec_double;
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+			switch (opts->decimal) {
+				case DEC_STRING:
+					return dec_decimal_string;
+				case DEC_SCALED:
+					return dec_decimal_scaled;
+				default:
+					return dec_decimal;
+			}
+		case CDATETYPE:
+			return opts->temporal ? dec_date_number : dec_date;
+		case CDTIMETYPE:
+			return opts->temporal ? dec_dtime_number : dec_dtime;
+		case CINVTYPE:
+			return opts->temporal ? dec_intrvl_number : dec_intrvl;
+		case CLOCATORTYPE:
+			return dec_locator;
+		case CROWTYPE:
+		case CCOLLTYPE:
+		case CLVCHARTYPE:
+			return dec_binary;
+		case CBOOLTYPE:
+			return dec_bool;
+		case SQLUDTFIXED:
+			return dec_lob;
+		default:
+			return dec_unknown;
+	}
+}
+
+
+/*
+** Set the fetch option named at index idx to the value at idx+1.
+** Return the option number.
+*/
+#define OPT_LOB		3
+
+static int setoption (lua_State *L, fetch_opts *opts, int idx) {
+	static const char *const names[] = {"decimal", "trim", "temporal", "lob", NULL};
+	static const char *const decimal_modes[] = {"number", "string", "scaled", NULL};
+	static const char *const temporal_modes[] = {"string", "number", NULL};
+	static const char *const lob_modes[] = {"value", "handle", NULL};
+	int opt = luaL_checkoption(L, idx, NULL, names);
+
+	switch (opt) {
+		case 0:
+			opts->decimal = luaL_checkoption(L, idx + 1, NULL, decimal_modes);
+			break;
+		case 1:
+			luaL_checktype(L, idx + 1, LUA_TBOOLEAN);
+			opts->trim = lua_toboolean(L, idx + 1);
+			break;
+		case 2:
+			opts->temporal = luaL_checkoption(L, idx + 1, NULL, temporal_modes);
+			break;
+		case OPT_LOB:
+			opts->lob = luaL_checkoption(L, idx + 1, NULL, lob_modes);
+			break;
+	}
+	return opt;
+}
+
+
+/*
+** Approximate memory of the value on top of the stack.
+*/
+inline static size_t valuebytes (lua_State *L) {
+	size_t len = 0;
+
+	if (lua_type(L, -1) == LUA_TSTRING)
+		lua_tolstring(L, -1, &len);
+	return len + sizeof(lua_Number);
+}
+
+
+/*
+** Push the value of column #i of the fetched row.
+*/
+inline static void pushvalue (lua_State *L, cur_data *cur, int i) {
+	ifx_sqlvar_t *sqlvar = cur->cur_sqlda->sqlvar + i;
+
+	if (*(sqlvar->sqlind) == -1)
+		lua_pushnil(L);
+	else
+		cur->decoders[i](L, cur, sqlvar);
+}
+
+
+/*
+** Push error message from sqlca 
+*/
+static void pusherrmsg (lua_State *L, ifx_sqlca_t *p_sqlca, char *hint) {
+	if (p_sqlca->sqlcode == 0) {
+		lua_pushnil(L);
+	}
+	else if ((p_sqlca->sqlcode == SQL_INTERRUPTED) && (active_conn != NULL) && (active_conn->broken != NULL)) {
+		lua_pushfstring(L, "%s fail, CODE:%d ISAM:%d MSG:%s",
+			hint, p_sqlca->sqlcode, p_sqlca->sqlerrd[1], active_conn->broken);
+	}
+	else {
+		lua_pushfstring(L, "%s fail, CODE:%d ISAM:%d MSG:%s",
+			hint, p_sqlca->sqlcode, p_sqlca->sqlerrd[1], p_sqlca->sqlerrm);
+	}
+}
+
+
+/*
+** Get the internal database type name of the given column.
+*/
+static char *getcolumntype (int type) {
+	switch (type) {
+		case CCHARTYPE:
+		case CVCHARTYPE:
+		case CSTRINGTYPE:
+			return "string";
+		case CSHORTTYPE:
+		case CINTTYPE:
+		case CBIGINTTYPE:
+		case CINT8TYPE:
+			return "integer";
+		case CFLOATTYPE:
+		case CDOUBLETYPE:
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+			return "number";
+		case CDATETYPE:
+			return "date";
+		case CDTIMETYPE:
+		case CINVTYPE:
+			return "datetime";
+		case CLOCATORTYPE:
+		case CROWTYPE:
+		case CLVCHARTYPE:
+		case CFIXBINTYPE:
+		case CVARBINTYPE:
+		case SQLUDTFIXED:
+			return "binary";
+		case CCOLLTYPE:
+			return "collection";
+		case CBOOLTYPE:
+			return "boolean";
+		default:
+			return "unknown";
+	}
+}
+
+
+/*
+** Get the internal database type length
+*/
+static void getcolumntypelen (int type,long len,int *out_len1,int *out_len2) {
+	*out_len1 = -1;
+	*out_len2 = -1;
+
+	switch (type) {
+		case CCHARTYPE:
+		case CVCHARTYPE:
+		case CSTRINGTYPE:
+			*out_len1 = len - 1;
+			return ;
+		case CSHORTTYPE:
+		case CINTTYPE:
+		case CBIGINTTYPE:
+		case CINT8TYPE:
+			return ;
+		case CFLOATTYPE:
+			*out_len1 = 4;
+			return ;
+		case CDOUBLETYPE:
+			*out_len1 = 8;
+			return ;
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+			*out_len1 = PRECTOT(len);
+			*out_len2 = PRECDEC(len);
+			return ;
+		case CDATETYPE:
+			return ;
+		case CDTIMETYPE:
+		case CINVTYPE:
+			{
+				*out_len1 = TU_START(len);
+				*out_len2 = TU_END(len);
+				return ;
+			}
+		case CLOCATORTYPE:
+		case CROWTYPE:
+		case CLVCHARTYPE:
+		case CFIXBINTYPE:
+		case CVARBINTYPE:
+		case SQLUDTFIXED:
+			return ;
+		case CCOLLTYPE:
+			return ;
+		case CBOOLTYPE:
+			return ;
+		default:
+			return ;
+	}
+}
+
+
+/*
+** Creates the lists of fields names and fields types.
+*/
+static void create_colinfo (lua_State *L, cur_data *cur) {
 	char typename[64];
 	int len_max,len_min;
 	int i;
 	ifx_sqlvar_t *sqlvar = NULL;
 
-	lua_newtable(L); /* names */
-	lua_newtable(L); /* types */
-	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
-		lua_pushstring(L, sqlvar->sqlname);
-		lua_rawseti(L, -3, i+1);
-		getcolumntypelen(sqlvar->sqltype, sqlvar->sqllen, &len_max, &len_min);
-		if ((len_max == -1) && (len_min == -1))
-			snprintf(typename, sizeof(typename), "%.20s", getcolumntype(sqlvar->sqltype));
-		else if (len_min == -1)
-			snprintf(typename, sizeof(typename), "%.20s(%d)", getcolumntype(sqlvar->sqltype), len_max);
-		else
-			snprintf(typename, sizeof(typename), "%.20s(%d,%d)", getcolumntype(sqlvar->sqltype), len_max, len_min);
-		lua_pushstring(L, typename);
-		lua_rawseti(L, -2, i+1);
+	lua_newtable(L); /* names */
+	lua_newtable(L); /* types */
+	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
+		lua_pushstring(L, sqlvar->sqlname);
+		lua_rawseti(L, -3, i+1);
+		getcolumntypelen(sqlvar->sqltype, sqlvar->sqllen, &len_max, &len_min);
+		if ((len_max == -1) && (len_min == -1))
+			snprintf(typename, sizeof(typename), "%.20s", getcolumntype(sqlvar->sqltype));
+		else if (len_min == -1)
+			snprintf(typename, sizeof(typename), "%.20s(%d)", getcolumntype(sqlvar->sqltype), len_max);
+		else
+			snprintf(typename, sizeof(typename), "%.20s(%d,%d)", getcolumntype(sqlvar->sqltype), len_max, len_min);
+		lua_pushstring(L, typename);
+		lua_rawseti(L, -2, i+1);
+	}
+	/* Stores the references in the cursor structure */
+	cur->coltypes = luaL_ref (L, LUA_REGISTRYINDEX);
+	cur->colnames = luaL_ref (L, LUA_REGISTRYINDEX);
+}
+
+
+/*
+** Take a cursor arena of the given size from the pool of the
+** connection, or allocate a new one.
+*/
+static char *arena_get (conn_data *conn, size_t size) {
+	arena_blk **p;
+
+	for (p = &(conn->arenas); *p != NULL; p = &((*p)->next)) {
+		if ((*p)->size == size) {
+			arena_blk *blk = *p;
+			*p = blk->next;
+			conn->narenas--;
+			return (char *)blk;
+		}
+	}
+	conn->stats.buffer_bytes += size;
+	return (char *)malloc(size);
+}
+
+
+/*
+** Give a cursor arena back to the pool of the connection, dropping
+** the least recently pooled one if the pool is full.
+*/
+static void arena_put (conn_data *conn, char *arena, size_t size) {
+	arena_blk *blk = (arena_blk *)arena;
+
+	if (conn->closed) {
+		free(arena);
+		return;
+	}
+	blk->size = size;
+	blk->next = conn->arenas;
+	conn->arenas = blk;
+	if (++(conn->narenas) > ARENA_POOL_SIZE) {
+		arena_blk **p = &(conn->arenas);
+		while ((*p)->next != NULL)
+			p = &((*p)->next);
+		free(*p);
+		*p = NULL;
+		conn->narenas--;
+	}
+}
+
+
+/*
+** Free the pooled arenas of the connection.
+*/
+static void arena_flush (conn_data *conn) {
+	while (conn->arenas != NULL) {
+		arena_blk *blk = conn->arenas;
+		conn->arenas = blk->next;
+		free(blk);
+	}
+	conn->narenas = 0;
+}
+
+
+/*
+** Slow statements of the process, in a ring written without locks:
+** a writer takes a ticket, clears the seq of its slot, fills it in and
+** sets seq to ticket+1. Readers keep a slot only if its seq is the same
+** before and after copying it.
+*/
+typedef struct {
+	volatile unsigned long seq;
+	env_data *env;
+	double	when;				/* wall clock */
+	double	elapsed;
+	long	rows;
+	int		sqlcode;
+	char	conn[MAX_NAME_LENGTH];
+	char	sql[SLOWLOG_SQL_SIZE];
+} slow_entry;
+
+static slow_entry slowlog[SLOWLOG_SIZE];
+static volatile unsigned long slowlog_next = 0;
+
+
+static void slowlog_add (conn_data *conn, const char *sql, size_t len, double elapsed, long rows, int code) {
+	unsigned long t = __sync_fetch_and_add(&slowlog_next, 1);
+	slow_entry *e = &(slowlog[t & (SLOWLOG_SIZE - 1)]);
+
+	e->seq = 0;
+	__sync_synchronize();
+	e->env = conn->envp;
+	e->when = (double)time(NULL);
+	e->elapsed = elapsed;
+	e->rows = rows;
+	e->sqlcode = code;
+	snprintf(e->conn, sizeof(e->conn), "%s", conn->conn_name);
+	if (len >= sizeof(e->sql))
+		len = sizeof(e->sql) - 1;
+	memcpy(e->sql, sql, len);
+	e->sql[len] = '\0';
+	__sync_synchronize();
+	e->seq = t + 1;
+}
+
+
+/*
+** Push the SQL text with its literals normalized: quoted strings and
+** numbers become ?, runs of blanks one space, the rest lower case.
+*/
+static void pushfingerprint (lua_State *L, const char *sql, size_t len) {
+	luaL_Buffer b;
+	const char *p = sql, *end = sql + len;
+	int blank = 0, ident = 0, out = 0;
+	char q;
+
+	luaL_buffinit(L, &b);
+	while (p < end) {
+		unsigned char c = (unsigned char)*p;
+		if (isspace(c)) {
+			blank = 1;
+			p++;
+			continue;
+		}
+		if (blank && out)
+			luaL_addchar(&b, ' ');
+		blank = 0;
+		out = 1;
+		if ((c == '\'') || (c == '"')) {
+			/* a doubled quote stays in the literal */
+			for (q = *p++; p < end; p++) {
+				if (*p == q) {
+					if ((p + 1 < end) && (p[1] == q))
+						p++;
+					else
+						break;
+				}
+			}
+			p++;
+			luaL_addchar(&b, '?');
+			ident = 0;
+		}
+		else if (!ident && (isdigit(c) || ((c == '.') && (p + 1 < end) && isdigit((unsigned char)p[1])))) {
+			while ((p < end) && (isalnum((unsigned char)*p) || (*p == '.')
+			  || (((*p == '+') || (*p == '-')) && ((p[-1] == 'e') || (p[-1] == 'E')))))
+				p++;
+			luaL_addchar(&b, '?');
+		}
+		else {
+			luaL_addchar(&b, tolower(c));
+			ident = isalnum(c) || (c == '_');
+			p++;
+		}
+	}
+	luaL_pushresult(&b);
+}
+
+
+/*
+** Report a finished statement: to the slow log if it took conn->slow
+** seconds or more, and to the hook of the connection as
+** hook(sql, fingerprint, elapsed, rows, sqlcode). Errors of the hook
+** are dropped, it must not break the statement it watches.
+*/
+static void query_event (lua_State *L, conn_data *conn, const char *sql, size_t len, double elapsed, long rows, int code) {
+	if ((conn->slow >= 0) && (elapsed >= conn->slow))
+		slowlog_add(conn, sql, len, elapsed, rows, code);
+	if (conn->hook == LUA_NOREF)
+		return;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, conn->hook);
+	lua_pushlstring(L, sql, len);
+	pushfingerprint(L, sql, len);
+	lua_pushnumber(L, elapsed);
+	lua_pushinteger(L, rows);
+	lua_pushinteger(L, code);
+	if (lua_pcall(L, 5, 0, 0) != 0)
+		lua_pop(L, 1);
+}
+
+
+/*
+** Report a query when its cursor is done with.
+*/
+static void cursor_event (lua_State *L, conn_data *conn, cur_data *cur) {
+	const char *sql;
+	size_t len;
+
+	if (cur->sql == LUA_NOREF)
+		return;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, cur->sql);
+	sql = lua_tolstring(L, -1, &len);
+	query_event(L, conn, sql, len, now_seconds() - cur->started, cur->rows,
+		(cur->sqlcode == 100) ? 0 : cur->sqlcode);
+	lua_pop(L, 1);
+	luaL_unref(L, LUA_REGISTRYINDEX, cur->sql);
+	cur->sql = LUA_NOREF;
+}
+
+
+static void result_unref (result_entry *e);
+static void capture_drop (cur_data *cur);
+
+
+/*
+** Closes the cursos and nullify all structure fields.
+*/
+static void cur_nullify (lua_State *L, cur_data *cur) {
+	/* Nullify structure fields. */
+	conn_data *conn = getconnfromref(L, cur->conn);
+	ifx_sqlvar_t *sqlvar = NULL;
+	int cached = (cur->result != NULL);
+	int i;
+
+	if (cur->replay != NULL) {
+		replay_data *rep = cur->replay->rep;
+		rep->open--;
+		luaL_unref(L, LUA_REGISTRYINDEX, cur->replay_obj);
+		cur->replay_obj = LUA_NOREF;
+	}
+	else if (cur->result != NULL) {
+		cursor_event(L, conn, cur);
+		result_unref(cur->result);
+		cur->result = NULL;
+	}
+	else {
+		/* keep why a failed fetch was interrupted for its error message */
+		const char *broken = conn->broken;
+		if (cur->capture != NULL)
+			capture_drop(cur);
+		if (!(conn->closed)) {
+			set_conn(L, conn);
+			sqli_curs_close(ESQLINTVERSION, cur->curs);
+			conn->lookups_skipped++;
+		}
+		cursor_event(L, conn, cur);
+		conn->broken = broken;
+		sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, cur->cur_name, 770));
+	}
+	cur->closed = 1;
+	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
+		/* the BLOB/CLOB columns of a cached result point at its cells */
+		if ((sqlvar->sqltype == CLOCATORTYPE) && !cached) {
+			ifx_loc_t *p = (ifx_loc_t *)sqlvar->sqldata;
+			if (p->loc_buffer != NULL)
+				free(p->loc_buffer);
+		}
+	}
+	arena_put(conn, cur->arena, cur->arena_size);
+	luaL_unref(L, LUA_REGISTRYINDEX, cur->conn);
+	luaL_unref(L, LUA_REGISTRYINDEX, cur->colnames);
+	luaL_unref(L, LUA_REGISTRYINDEX, cur->coltypes);
+}
+
+
+/*
+** Get an integer field of the option table at index idx.
+*/
+static int getoptint (lua_State *L, int idx, const char *name, int def) {
+	int value = def;
+
+	if (lua_istable(L, idx)) {
+		lua_getfield(L, idx, name);
+		if (lua_isnumber(L, -1))
+			value = (int)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+	}
+	return value;
+}
+
+
+/*
+** Row table layouts of fetch options.
+*/
+#define ROW_NUM		1			/* 'n': values at numerical indices */
+#define ROW_ALPHA	2			/* 'a': values keyed by column names */
+
+static int rowmode (const char *opts) {
+	int mode = 0;
+
+	if (strchr (opts, 'n') != NULL)
+		mode |= ROW_NUM;
+	if (strchr (opts, 'a') != NULL)
+		mode |= ROW_ALPHA;
+	return mode;
+}
+
+
+/*
+** Trace files of conn:settrace, replayed by conn:replay. After a
+** header of the magic, version and byte order mark, each record is
+** a kind byte, the cursor id (int4), the microseconds from the start
+** of the trace (bigint) and the payload length (int4), then:
+**   'D' describe: SQL length (int4) and text, sqld (int2), fetch
+**       buffer length (int4), and per column its sqltype (int2),
+**       sqllen, sqlxid and buffer offset (int4) and name length (int2)
+**       and text, as set up in the cursor arena;
+**   'R' row: the indicators, the raw fetch buffer, then per locator
+**       column its data length (int4, -1 if none) and data;
+**   'E' end: the sqlcode of the fetch that ended the cursor.
+** Values are in the byte order and layout of the writing host, so a
+** trace replays on a build for the same platform only.
+*/
+#define TRACE_MAGIC		"IFXTRACE"
+#define TRACE_VERSION	1
+#define TRACE_ORDER		0x01020304
+#define TRACE_HEAD		(sizeof(TRACE_MAGIC) - 1 + 2 * sizeof(int4))
+#define TRACE_REC		(1 + sizeof(int4) + sizeof(bigint) + sizeof(int4))
+#define TRACE_COL		(2 * sizeof(int2) + 3 * sizeof(int4))	/* column before its name */
+#define TRACE_DESCRIBE	'D'
+#define TRACE_ROW		'R'
+#define TRACE_END		'E'
+
+static void trace_put (conn_data *conn, const void *p, size_t n) {
+	if ((n > 0) && (fwrite(p, 1, n, conn->trace) != n))
+		conn->trace_failed = 1;
+}
+
+static void trace_int4 (conn_data *conn, int4 v) {
+	trace_put(conn, &v, sizeof(int4));
+}
+
+static void trace_int2 (conn_data *conn, int2 v) {
+	trace_put(conn, &v, sizeof(int2));
+}
+
+static void trace_record (conn_data *conn, char kind, unsigned int id, size_t len) {
+	bigint usec = (bigint)((now_seconds() - conn->trace_start) * 1e6);
+
+	trace_put(conn, &kind, 1);
+	trace_int4(conn, (int4)id);
+	trace_put(conn, &usec, sizeof(bigint));
+	trace_int4(conn, (int4)len);
+}
+
+/*
+** Start tracing the cursor, opened over entry, on top of the stack.
+*/
+static void trace_describe (lua_State *L, conn_data *conn, stmt_entry *entry) {
+	cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+	ifx_sqlda_t *sqlda = cur->cur_sqlda;
+	ifx_sqlvar_t *sqlvar;
+	size_t len = sizeof(int4) + entry->sql_len + sizeof(int2) + sizeof(int4);
+	int i;
+
+	cur->trace_id = ++(conn->trace_ids);
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++)
+		len += sizeof(int2) + 3 * sizeof(int4) + sizeof(int2) + strlen(sqlvar->sqlname);
+	trace_record(conn, TRACE_DESCRIBE, cur->trace_id, len);
+	trace_int4(conn, (int4)entry->sql_len);
+	trace_put(conn, entry->sql, entry->sql_len);
+	trace_int2(conn, sqlda->sqld);
+	trace_int4(conn, (int4)(cur->arena_size - (cur->buf - cur->arena)));
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
+		size_t n = strlen(sqlvar->sqlname);
+		trace_int2(conn, sqlvar->sqltype);
+		trace_int4(conn, sqlvar->sqllen);
+		trace_int4(conn, sqlvar->sqlxid);
+		trace_int4(conn, (int4)(sqlvar->sqldata - cur->buf));
+		trace_int2(conn, (int2)n);
+		trace_put(conn, sqlvar->sqlname, n);
+	}
+}
+
+/*
+** Write the row just fetched, or the end of the cursor.
+*/
+static void trace_fetch (conn_data *conn, cur_data *cur, int sqlcode) {
+	ifx_sqlda_t *sqlda = cur->cur_sqlda;
+	ifx_sqlvar_t *sqlvar;
+	size_t buflen = cur->arena_size - (cur->buf - cur->arena);
+	size_t len = sqlda->sqld * sizeof(int2) + buflen;
+	int i;
+
+	if (sqlcode != 0) {
+		trace_record(conn, TRACE_END, cur->trace_id, sizeof(int4));
+		trace_int4(conn, sqlcode);
+		return;
+	}
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
+		if (sqlvar->sqltype == CLOCATORTYPE) {
+			ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+			len += sizeof(int4);
+			if ((*(sqlvar->sqlind) != -1) && (loc->loc_buffer != NULL))
+				len += loc->loc_size;
+		}
+	}
+	trace_record(conn, TRACE_ROW, cur->trace_id, len);
+	trace_put(conn, cur->indicators, sqlda->sqld * sizeof(int2));
+	trace_put(conn, cur->buf, buflen);
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
+		if (sqlvar->sqltype == CLOCATORTYPE) {
+			ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+			if ((*(sqlvar->sqlind) != -1) && (loc->loc_buffer != NULL)) {
+				trace_int4(conn, loc->loc_size);
+				trace_put(conn, loc->loc_buffer, loc->loc_size);
+			}
+			else
+				trace_int4(conn, -1);
+		}
+	}
+}
+
+/*
+** Stop tracing. Return non zero if a write to the trace failed.
+*/
+static int trace_close (conn_data *conn) {
+	int failed;
+
+	if (conn->trace == NULL)
+		return 0;
+	failed = conn->trace_failed | (fclose(conn->trace) != 0);
+	conn->trace = NULL;
+	conn->trace_failed = 0;
+	return failed;
+}
+
+
+/*
+** Wait for a time of a timed replay.
+*/
+static void replay_wait (replay_data *rep, double ts) {
+	double left;
+
+	while ((left = rep->start + ts - now_seconds()) > 0)
+		usleep((left > 1) ? 1000000 : (useconds_t)(left * 1e6));
+}
+
+/*
+** Copy the next recorded row of a replayed cursor into its buffer.
+** Return the sqlcode as fetch_row does, the recorded one at the end.
+*/
+static int replay_fetch (cur_data *cur, conn_data *conn) {
+	trace_cursor *tc = cur->replay;
+	ifx_sqlvar_t *sqlvar;
+	const char *p;
+	bigint usec;
+	int4 n;
+	int i;
+
+	memset(&(conn->conn_sqlca), 0, sizeof(ifx_sqlca_t));
+	if (cur->replay_pos >= tc->nrows) {
+		conn->conn_sqlca.sqlcode = tc->endcode;
+		cur->sqlcode = tc->endcode;
+		return tc->endcode;
+	}
+	p = tc->rows[cur->replay_pos++];
+	if (tc->rep->timed) {
+		memcpy(&usec, p + 1 + sizeof(int4), sizeof(bigint));
+		replay_wait(tc->rep, usec / 1e6);
+	}
+	p += TRACE_REC;
+	memcpy(cur->indicators, p, tc->sqld * sizeof(int2));
+	p += tc->sqld * sizeof(int2);
+	if (tc->has_loc) {
+		/* the locators get buffers of their own, not the recorded pointers */
+		for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < tc->sqld; i++, sqlvar++) {
+			if (sqlvar->sqltype == CLOCATORTYPE) {
+				ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+				free(loc->loc_buffer);
+				loc->loc_buffer = NULL;
+			}
+		}
+	}
+	memcpy(cur->buf, p, tc->buflen);
+	p += tc->buflen;
+	if (tc->has_loc) {
+		for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < tc->sqld; i++, sqlvar++) {
+			if (sqlvar->sqltype == CLOCATORTYPE) {
+				ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+				memcpy(&n, p, sizeof(int4));
+				p += sizeof(int4);
+				loc->loc_buffer = NULL;
+				if (n < 0)
+					continue;
+				loc->loc_buffer = (char *)malloc(n + 1);
+				if (loc->loc_buffer == NULL) {
+					conn->conn_sqlca.sqlcode = -208;	/* memory allocation failed */
+					cur->sqlcode = -208;
+					return -208;
+				}
+				memcpy(loc->loc_buffer, p, n);
+				loc->loc_size = n;
+				p += n;
+			}
+		}
+	}
+	conn->stats.rows++;
+	cur->rows++;
+	cur->sqlcode = 0;
+	return 0;
+}
+
+
+/*
+** Tokens of SQL text, for the result cache: names and single
+** characters. Blanks, comments and string literals are skipped.
+*/
+#define TOK_END		0
+#define TOK_NAME	'a'
+
+/*
+** Scan the next token of the SQL text at *p. A name, qualified as in
+** db@server:owner.table and possibly quoted, is copied lower cased into
+** tok from its last part. String literals give a quote token.
+*/
+static int sql_token (const char **p, const char *end, char *tok, size_t size) {
+	const char *s = *p;
+	size_t n = 0;
+
+	for (;;) {
+		while ((s < end) && isspace((unsigned char)*s))
+			s++;
+		if ((s + 1 < end) && (s[0] == '-') && (s[1] == '-')) {
+			while ((s < end) && (*s != '\n'))
+				s++;
+		}
+		else if ((s < end) && (*s == '{')) {
+			while ((s < end) && (*s != '}'))
+				s++;
+			if (s < end)
+				s++;
+		}
+		else if ((s + 1 < end) && (s[0] == '/') && (s[1] == '*')) {
+			for (s += 2; (s + 1 < end) && !((s[0] == '*') && (s[1] == '/')); s++)
+				;
+			s = (s + 1 < end) ? s + 2 : end;
+		}
+		else
+			break;
+	}
+	if (s >= end) {
+		*p = s;
+		return TOK_END;
+	}
+	if (*s == '\'') {
+		for (s++; s < end; s++) {
+			if (*s == '\'') {
+				if ((s + 1 < end) && (s[1] == '\''))
+					s++;
+				else
+					break;
+			}
+		}
+		*p = (s < end) ? s + 1 : end;
+		return '\'';
+	}
+	if (!isalnum((unsigned char)*s) && (*s != '_') && (*s != '"')) {
+		*p = s + 1;
+		return *s;
+	}
+	while (s < end) {
+		if (*s == '"') {
+			for (s++; (s < end) && (*s != '"'); s++) {
+				if (n + 1 < size)
+					tok[n++] = tolower((unsigned char)*s);
+			}
+			if (s < end)
+				s++;
+		}
+		else if (isalnum((unsigned char)*s) || (*s == '_') || (*s == '$')) {
+			if (n + 1 < size)
+				tok[n++] = tolower((unsigned char)*s);
+			s++;
+		}
+		else if (((*s == '.') || (*s == ':') || (*s == '@')) && (s + 1 < end)
+		  && (isalnum((unsigned char)s[1]) || (s[1] == '_') || (s[1] == '"'))) {
+			n = 0;				/* keep the last part */
+			s++;
+		}
+		else
+			break;
+	}
+	tok[n] = '\0';
+	*p = s;
+	return TOK_NAME;
+}
+
+
+static int sql_word_in (const char *word, const char *const *list) {
+	for (; *list != NULL; list++) {
+		if (strcmp(word, *list) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+** Check whether name is in a NUL separated list ending with "".
+*/
+static int name_in (const char *list, const char *name) {
+	for (; *list != '\0'; list += strlen(list) + 1) {
+		if (strcmp(list, name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+** Collect the names of the tables a SELECT reads into out, from its
+** FROM and JOIN clauses, subqueries included. Aliases are taken as
+** well, which only drops its cached results more often.
+** Return the length of the list, 0 if the statement is not a SELECT
+** that can be cached (SELECT INTO, FOR UPDATE) or names no table.
+*/
+static size_t sql_read_tables (const char *sql, size_t len, char *out, size_t size) {
+	static const char *const stops[] = {
+		"where", "group", "order", "having", "union", "on", "using", "intersect",
+		"except", "minus", "limit", "connect", "start", NULL
+	};
+	static const char *const skips[] = {
+		"as", "outer", "inner", "left", "right", "full", "cross", "natural",
+		"lateral", "only", "table", NULL
+	};
+	const char *p = sql, *end = sql + len;
+	char tok[MAX_NAME_LENGTH];
+	size_t n = 0, l;
+	int t, list = 0;
+
+	if ((sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME) || (strcmp(tok, "select") != 0))
+		return 0;
+	while ((t = sql_token(&p, end, tok, sizeof(tok))) != TOK_END) {
+		if (t != TOK_NAME) {
+			if (t != ',')
+				list = 0;
+			continue;
+		}
+		if ((strcmp(tok, "into") == 0) || (strcmp(tok, "update") == 0))
+			return 0;
+		if ((strcmp(tok, "from") == 0) || (strcmp(tok, "join") == 0)) {
+			list = 1;
+			continue;
+		}
+		if (!list || sql_word_in(tok, skips))
+			continue;
+		if (sql_word_in(tok, stops)) {
+			list = 0;
+			continue;
+		}
+		out[n] = '\0';
+		if ((tok[0] == '\0') || name_in(out, tok))
+			continue;
+		l = strlen(tok) + 1;
+		if (n + l + 1 > size)
+			return 0;
+		memcpy(out + n, tok, l);
+		n += l;
+	}
+	if (n == 0)
+		return 0;
+	out[n++] = '\0';
+	return n;
+}
+
+
+/*
+** Find the table an SQL statement writes to, copied into name.
+** Return 1 if found, 0 if the statement writes no table (or only new
+** ones) and -1 if it may write any, as a procedure call may.
+*/
+static int sql_written (const char *sql, size_t len, char *name, size_t size) {
+	const char *p = sql, *end = sql + len;
+	char tok[MAX_NAME_LENGTH];
+
+	if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+		return 0;
+	if ((strcmp(tok, "insert") == 0) || (strcmp(tok, "merge") == 0)) {
+		if ((sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME) || (strcmp(tok, "into") != 0))
+			return -1;
+		if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+			return -1;
+	}
+	else if (strcmp(tok, "delete") == 0) {
+		if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+			return -1;
+		if ((strcmp(tok, "from") == 0) && (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME))
+			return -1;
+	}
+	else if (strcmp(tok, "update") == 0) {
+		if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+			return -1;
+		if (strcmp(tok, "statistics") == 0)
+			return 0;
+	}
+	else if (strcmp(tok, "truncate") == 0) {
+		if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+			return -1;
+		if (((strcmp(tok, "table") == 0) || (strcmp(tok, "only") == 0))
+		  && (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME))
+			return -1;
+	}
+	else if ((strcmp(tok, "drop") == 0) || (strcmp(tok, "alter") == 0) || (strcmp(tok, "rename") == 0)) {
+		if ((sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME) ||
+		  ((strcmp(tok, "table") != 0) && (strcmp(tok, "view") != 0) && (strcmp(tok, "synonym") != 0)))
+			return 0;
+		if (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+			return -1;
+		if ((strcmp(tok, "if") == 0) && ((sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)
+		  || (sql_token(&p, end, tok, sizeof(tok)) != TOK_NAME)))
+			return -1;			/* IF EXISTS */
+	}
+	else if ((strcmp(tok, "execute") == 0) || (strcmp(tok, "call") == 0))
+		return -1;
+	else
+		return 0;
+	if (tok[0] == '\0')
+		return -1;
+	snprintf(name, size, "%s", tok);
+	return 1;
+}
+
+
+/*
+** Cells of cached rows: a tag byte, then the column as fetched. A
+** string keeps its bytes up to the NUL (a CHAR up to its blank padding)
+** and a BLOB/CLOB its buffer; other columns are copied as they are.
+*/
+#define CELL_NIL		0
+#define CELL_RAW		1			/* the fetch buffer of the column, cell_size bytes */
+#define CELL_SHORT		2			/* up to 255 bytes, length byte */
+#define CELL_STRING		3			/* bytes, int4 length */
+
+/*
+** Bytes of the fetch buffer of a column a CELL_RAW cell holds.
+*/
+static size_t cell_size (ifx_sqlvar_t *sqlvar) {
+	switch (sqlvar->sqltype) {
+		case CDTIMETYPE:
+		case CINVTYPE:
+		case CDECIMALTYPE:
+		case CMONEYTYPE:
+			/* sqllen is the qualifier or precision */
+			return rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
+		default:
+			return sqlvar->sqllen;
+	}
+}
+
+/*
+** Make room for n more bytes of cells in the entry, return where they
+** go or NULL if out of memory.
+*/
+static char *cell_room (result_entry *e, size_t n) {
+	char *p;
+
+	if (e->len + n > e->cap) {
+		size_t cap = (e->cap == 0) ? 256 : e->cap;
+		while (cap < e->len + n)
+			cap *= 2;
+		p = (char *)realloc(e->rows, cap);
+		if (p == NULL)
+			return NULL;
+		e->rows = p;
+		e->cap = cap;
+	}
+	p = e->rows + e->len;
+	e->len += n;
+	return p;
+}
+
+/*
+** Append len bytes at s as a string cell.
+** Return 0 if memory ran out.
+*/
+static int cell_bytes (result_entry *e, const char *s, size_t len) {
+	char *p;
+	int4 n;
+
+	if (len <= 255) {
+		if ((p = cell_room(e, 2 + len)) == NULL)
+			return 0;
+		p[0] = CELL_SHORT;
+		p[1] = (char)(unsigned char)len;
+		memcpy(p + 2, s, len);
+		return 1;
+	}
+	if ((p = cell_room(e, 1 + sizeof(int4) + len)) == NULL)
+		return 0;
+	n = (int4)len;
+	*p = CELL_STRING;
+	memcpy(p + 1, &n, sizeof(int4));
+	memcpy(p + 1 + sizeof(int4), s, len);
+	return 1;
+}
+
+/*
+** Append the fetched column to the rows of the entry, without decoding
+** it. Return 0 if memory ran out.
+*/
+static int cell_put (result_entry *e, ifx_sqlvar_t *sqlvar) {
+	ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+	char *p;
+	size_t n;
+
+	if ((*(sqlvar->sqlind) == -1) || ((sqlvar->sqltype == CLOCATORTYPE) && (loc->loc_indicator == -1))) {
+		if ((p = cell_room(e, 1)) == NULL)
+			return 0;
+		*p = CELL_NIL;
+		return 1;
+	}
+	switch (sqlvar->sqltype) {
+		case CCHARTYPE:
+			return cell_bytes(e, sqlvar->sqldata, rtrim(sqlvar->sqldata, sqlvar->sqllen - 1));
+		case CSTRINGTYPE:
+		case CVCHARTYPE:
+			return cell_bytes(e, sqlvar->sqldata, strlen(sqlvar->sqldata));
+		case CLOCATORTYPE:
+			return cell_bytes(e, loc->loc_buffer, (loc->loc_buffer != NULL) ? loc->loc_size : 0);
+		default:
+			n = cell_size(sqlvar);
+			if ((p = cell_room(e, 1 + n)) == NULL)
+				return 0;
+			*p = CELL_RAW;
+			memcpy(p + 1, sqlvar->sqldata, n);
+			return 1;
+	}
+}
+
+/*
+** Copy the cell at p back into the fetch buffer of its column, a
+** BLOB/CLOB pointing at the cell. Return the next cell.
+*/
+static const char *cell_get (const char *p, ifx_sqlvar_t *sqlvar) {
+	const char *s;
+	int4 n;
+
+	*(sqlvar->sqlind) = 0;
+	switch (*p) {
+		case CELL_NIL:
+			*(sqlvar->sqlind) = -1;
+			return p + 1;
+		case CELL_RAW:
+			n = (int4)cell_size(sqlvar);
+			memcpy(sqlvar->sqldata, p + 1, n);
+			return p + 1 + n;
+		case CELL_SHORT:
+			n = (unsigned char)p[1];
+			s = p + 2;
+			break;
+		default:
+			memcpy(&n, p + 1, sizeof(int4));
+			s = p + 1 + sizeof(int4);
+	}
+	switch (sqlvar->sqltype) {
+		case CCHARTYPE:
+			memcpy(sqlvar->sqldata, s, n);
+			memset(sqlvar->sqldata + n, ' ', sqlvar->sqllen - 1 - n);
+			sqlvar->sqldata[sqlvar->sqllen - 1] = '\0';
+			break;
+		case CLOCATORTYPE:
+			{
+				ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+				loc->loc_buffer = (char *)s;
+				loc->loc_size = n;
+				loc->loc_indicator = 0;
+				break;
+			}
+		default:
+			memcpy(sqlvar->sqldata, s, n);
+			sqlvar->sqldata[n] = '\0';
+	}
+	return s + n;
+}
+
+static void result_free (result_entry *e) {
+	free(e->rows);
+	free(e);
+}
+
+static void result_unref (result_entry *e) {
+	if ((--(e->refs) == 0) && !(e->cached))
+		result_free(e);
+}
+
+/*
+** Unlink an entry from the cache, it is freed once no cursor reads it.
+*/
+static void result_remove (result_cache *cache, result_entry *e) {
+	result_entry **p = &(cache->buckets[e->hash % RESULT_BUCKETS]);
+
+	while (*p != e)
+		p = &((*p)->hnext);
+	*p = e->hnext;
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		cache->head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		cache->tail = e->prev;
+	e->hnext = e->prev = e->next = NULL;
+	e->cached = 0;
+	cache->count--;
+	cache->bytes -= e->size;
+	if (e->refs == 0)
+		result_free(e);
+}
+
+/*
+** Drop the entries reading the table name, all of them if name is
+** NULL or "*". Results being filled are marked stale, so they are not
+** kept. Return the number of entries dropped.
+*/
+static int result_cache_drop (result_cache *cache, const char *name) {
+	int all = (name == NULL) || (strcmp(name, "*") == 0);
+	result_entry *e, *next;
+	int n = 0;
+
+	if (cache->buckets == NULL)
+		return 0;
+	for (e = cache->head; e != NULL; e = next) {
+		next = e->next;
+		if (all || name_in(e->tables, name)) {
+			result_remove(cache, e);
+			n++;
+		}
+	}
+	for (e = cache->capturing; e != NULL; e = e->next) {
+		if (all || name_in(e->tables, name))
+			e->stale = 1;
+	}
+	return n;
+}
+
+/*
+** Drop the least recently used entries while the cache is over size.
+*/
+static void result_cache_trim (result_cache *cache) {
+	while ((cache->bytes > cache->max_bytes) && (cache->tail != NULL)) {
+		result_remove(cache, cache->tail);
+		cache->evictions++;
+	}
+}
+
+static result_entry *result_find (result_cache *cache, const char *key, size_t len, unsigned int hash) {
+	result_entry *e;
+
+	for (e = cache->buckets[hash % RESULT_BUCKETS]; e != NULL; e = e->hnext) {
+		if ((e->hash == hash) && (e->key_len == len) && (memcmp(e->key, key, len) == 0))
+			return e;
+	}
+	return NULL;
+}
+
+/*
+** Drop the cached results reading a table written by the connection.
+** In a transaction the table is remembered, and its results dropped
+** again when it ends: other connections may have cached them from the
+** rows before its commit.
+*/
+static void result_invalidate (lua_State *L, conn_data *conn, const char *name) {
+	result_cache *cache = &(conn->envp->cache);
+
+	if (cache->buckets == NULL)
+		return;
+	cache->invalidations += result_cache_drop(cache, name);
+	if (conn->auto_commit)
+		return;
+	if (conn->written == LUA_NOREF) {
+		lua_newtable(L);
+		conn->written = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, conn->written);
+	lua_pushboolean(L, 1);
+	lua_setfield(L, -2, name);
+	lua_pop(L, 1);
+}
+
+/*
+** Drop the cached results reading the table an SQL statement writes.
+*/
+static void result_written (lua_State *L, conn_data *conn, const char *sql, size_t len) {
+	char name[MAX_NAME_LENGTH];
+	int w;
+
+	if (conn->envp->cache.buckets == NULL)
+		return;
+	w = sql_written(sql, len, name, sizeof(name));
+	if (w != 0)
+		result_invalidate(L, conn, (w > 0) ? name : "*");
+}
+
+/*
+** End the transaction of the connection for the result cache.
+*/
+static void result_txn_end (lua_State *L, conn_data *conn) {
+	result_cache *cache = &(conn->envp->cache);
+
+	if (conn->written == LUA_NOREF)
+		return;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, conn->written);
+	lua_pushnil(L);
+	while (lua_next(L, -2) != 0) {
+		lua_pop(L, 1);
+		cache->invalidations += result_cache_drop(cache, lua_tostring(L, -1));
+	}
+	lua_pop(L, 1);
+	luaL_unref(L, LUA_REGISTRYINDEX, conn->written);
+	conn->written = LUA_NOREF;
+}
+
+/*
+** Stop caching the rows of a cursor.
+*/
+static void capture_drop (cur_data *cur) {
+	result_entry *e = cur->capture;
+
+	cur->capture = NULL;
+	if (e->cache != NULL) {
+		if (e->prev != NULL)
+			e->prev->next = e->next;
+		else
+			e->cache->capturing = e->next;
+		if (e->next != NULL)
+			e->next->prev = e->prev;
+		e->prev = e->next = NULL;
+	}
+	result_unref(e);
+}
+
+/*
+** Add the fetched row to the result the cursor is caching. Stop
+** caching it if memory runs out, it grows over the size of an entry or
+** a table it reads was written.
+*/
+static void capture_row (cur_data *cur) {
+	result_entry *e = cur->capture;
+	ifx_sqlvar_t *sqlvar;
+	int i, ok = 1;
+
+	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; ok && (i < e->sqlda.sqld); i++, sqlvar++)
+		ok = cell_put(e, sqlvar);
+	if (!ok || e->stale || (e->cache == NULL) || (e->head_size + e->len > e->cache->max_entry))
+		capture_drop(cur);
+	else
+		e->nrows++;
+}
+
+/*
+** Keep the result a cursor cached, now that it reached its end, in the
+** cache of its environment.
+*/
+static void result_store (conn_data *conn, cur_data *cur) {
+	result_entry *e = cur->capture;
+	result_cache *cache = e->cache;
+	result_entry *old;
+
+	e->refs++;
+	capture_drop(cur);
+	if (e->stale || (cache == NULL) || (cache->max_bytes == 0) || (conn->written != LUA_NOREF)) {
+		result_unref(e);
+		return;
+	}
+	if ((e->len > 0) && (e->len < e->cap)) {
+		char *rows = (char *)realloc(e->rows, e->len);
+		if (rows != NULL) {
+			e->rows = rows;
+			e->cap = e->len;
+		}
+	}
+	e->size = e->head_size + e->cap;
+	if (e->size > cache->max_entry) {
+		result_unref(e);
+		return;
+	}
+	old = result_find(cache, e->key, e->key_len, e->hash);
+	if (old != NULL)
+		result_remove(cache, old);
+	e->expires = now_seconds() + e->ttl;
+	e->cached = 1;
+	e->refs--;
+	e->hnext = cache->buckets[e->hash % RESULT_BUCKETS];
+	cache->buckets[e->hash % RESULT_BUCKETS] = e;
+	e->next = cache->head;
+	if (cache->head != NULL)
+		cache->head->prev = e;
+	else
+		cache->tail = e;
+	cache->head = e;
+	cache->count++;
+	cache->bytes += e->size;
+	cache->stores++;
+	result_cache_trim(cache);
+}
+
+/*
+** Copy the next row of a cursor over a cached result into its buffer.
+** Return the sqlcode as fetch_row does.
+*/
+static int result_fetch (cur_data *cur, conn_data *conn) {
+	ifx_sqlvar_t *sqlvar;
+	const char *p = cur->result_pos;
+	int i;
+
+	memset(&(conn->conn_sqlca), 0, sizeof(ifx_sqlca_t));
+	if (cur->result_left == 0) {
+		conn->conn_sqlca.sqlcode = 100;
+		cur->sqlcode = 100;
+		return 100;
+	}
+	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++)
+		p = cell_get(p, sqlvar);
+	cur->result_pos = p;
+	cur->result_left--;
+	cur->rows++;
+	cur->sqlcode = 0;
+	return 0;
+}
+
+
+/*
+** Fetch directions of _FetchSpec.
+*/
+#define FETCH_NEXT		1
+#define FETCH_PRIOR		2
+#define FETCH_FIRST		3
+#define FETCH_LAST		4
+#define FETCH_RELATIVE	6
+#define FETCH_ABSOLUTE	7
+
+/*
+** Fetch the next row of the cursor into its buffer.
+** Return the sqlcode, 100 at the end of data.
+*/
+static int fetch_row (cur_data *cur, conn_data *conn) {
+	static _FetchSpec _FS0 = { 0, 1, 0 };
+
+	if (cur->replay != NULL)
+		return replay_fetch(cur, conn);
+	if (cur->result != NULL)
+		return result_fetch(cur, conn);
+	conn->lookups_skipped++;
+	sqli_curs_fetch(ESQLINTVERSION, cur->curs,
+		(ifx_sqlda_t *)0, cur->cur_sqlda, (char *)0, &_FS0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode == 0) {
+		conn->stats.rows++;
+		cur->rows++;
+	}
+	cur->sqlcode = sqlca.sqlcode;
+	if ((conn->trace != NULL) && (cur->trace_id != 0))
+		trace_fetch(conn, cur, sqlca.sqlcode);
+	if (cur->capture != NULL) {
+		if (cur->sqlcode == 0)
+			capture_row(cur);
+		else if (cur->sqlcode == 100)
+			result_store(conn, cur);
+		else
+			capture_drop(cur);
+	}
+	return cur->sqlcode;
+}
+
+
+/*
+** Fetch the row of a scroll cursor at a position into its buffer.
+** Return the sqlcode, 100 if there is no row there.
+*/
+static int fetch_at (cur_data *cur, conn_data *conn, int dir, long n) {
+	_FetchSpec fs;
+
+	fs.fval = (int4)n;
+	fs.fdir = dir;
+	fs.findchk = 0;
+	conn->lookups_skipped++;
+	sqli_curs_fetch(ESQLINTVERSION, cur->curs,
+		(ifx_sqlda_t *)0, cur->cur_sqlda, (char *)0, &fs);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode == 0) {
+		conn->stats.rows++;
+		cur->rows++;
+	}
+	cur->sqlcode = sqlca.sqlcode;
+	if ((conn->trace != NULL) && (cur->trace_id != 0) && (sqlca.sqlcode == 0))
+		trace_fetch(conn, cur, 0);
+	return sqlca.sqlcode;
+}
+
+
+/*
+** Copy the values of the fetched row into the table at index t.
+** Return the approximate memory of the values.
+*/
+static size_t setrow (lua_State *L, cur_data *cur, int t, int mode) {
+	int ncols = cur->cur_sqlda->sqld;
+	size_t bytes = 0;
+	int i;
+
+	if (mode & ROW_NUM) {
+		/* Copy values to numerical indices */
+		for (i = 0; i < ncols; i++) {
+			pushvalue(L, cur, i);
+			bytes += valuebytes(L);
+			lua_rawseti(L, t, i+1);
+		}
+	}
+	if (mode & ROW_ALPHA) {
+		/* Keys come from the column names table, no string is hashed */
+		lua_rawgeti(L, LUA_REGISTRYINDEX, cur->colnames);
+		for (i = 0; i < ncols; i++) {
+			lua_rawgeti(L, -1, i+1);
+			pushvalue(L, cur, i);
+			if (!(mode & ROW_NUM))
+				bytes += valuebytes(L);
+			lua_rawset(L, t);
+		}
+		lua_pop(L, 1);
+	}
+	return bytes;
+}
+
+
+/*
+** Push the fetched row: into the table at index t, laid out by the mode
+** at t+1, or as one value per column without a table. Add the
+** approximate memory of the values to *bytes.
+*/
+static int pushrow (lua_State *L, cur_data *cur, int t, size_t *bytes) {
+	if (lua_istable (L, t)) {
+		int mode = rowmode(luaL_optstring(L, t+1, "n"));
+		if ((mode & ROW_ALPHA) && (cur->colnames == LUA_NOREF))
+			create_colinfo(L, cur);
+		*bytes += setrow(L, cur, t, mode);
+		lua_pushvalue(L, t);
+		return 1; /* return table */
+	}
+	else {
+		int i;
+		luaL_checkstack (L, cur->cur_sqlda->sqld, LUASQL_PREFIX"too many columns");
+		for (i = 0; i < cur->cur_sqlda->sqld; i++) {
+			pushvalue(L, cur, i);
+			*bytes += valuebytes(L);
+		}
+		return cur->cur_sqlda->sqld; /* return value number */
+	}
+}
+
+
+/*
+** Get another row of the given cursor.
+*/
+static int cur_fetch (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	size_t bytes = 0;
+	double start;
+	int n;
+
+	set_conn(L, conn);
+	start = FETCH_CLOCK();
+	if (fetch_row(cur, conn) != 0) {
+		FETCH_DONE(conn, start, bytes);
+		/* a scroll cursor can still move back */
+		if (!(cur->scroll) || (conn->conn_sqlca.sqlcode != 100))
+			cur_nullify(L, cur);
+		lua_pushnil(L);
+		if (conn->conn_sqlca.sqlcode == 100) {
+			return 1;
+		}
+		pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+		return 2;
+	}
+	n = pushrow(L, cur, 2, &bytes);
+	FETCH_DONE(conn, start, bytes);
+	return n;
+}
+
+
+/*
+** Fetch the row of a scroll cursor at a position, return it as fetch
+** does with its table and mode arguments from index t. Return nil if
+** there is no row there; the cursor stays open.
+*/
+static int fetch_pos (lua_State *L, int dir, long n, int t) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	size_t bytes = 0;
+	double start;
+	int ret;
+
+	luaL_argcheck(L, cur->scroll, 1, "scroll cursor expected");
+	set_conn(L, conn);
+	start = FETCH_CLOCK();
+	if (fetch_at(cur, conn, dir, n) != 0) {
+		FETCH_DONE(conn, start, bytes);
+		lua_pushnil(L);
+		if (conn->conn_sqlca.sqlcode == 100) {
+			return 1;
+		}
+		pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+		return 2;
+	}
+	ret = pushrow(L, cur, t, &bytes);
+	FETCH_DONE(conn, start, bytes);
+	return ret;
+}
+
+
+/*
+** cur:fetch_absolute(n [, table [, mode]]), the first row is 1.
+*/
+static int cur_fetch_absolute (lua_State *L) {
+	return fetch_pos(L, FETCH_ABSOLUTE, (long)luaL_checknumber(L, 2), 3);
+}
+
+
+/*
+** cur:fetch_relative(k [, table [, mode]]), k rows after (before if
+** negative) the current one.
+*/
+static int cur_fetch_relative (lua_State *L) {
+	return fetch_pos(L, FETCH_RELATIVE, (long)luaL_checknumber(L, 2), 3);
+}
+
+
+static int cur_first (lua_State *L) {
+	return fetch_pos(L, FETCH_FIRST, 0, 2);
+}
+
+
+static int cur_last (lua_State *L) {
+	return fetch_pos(L, FETCH_LAST, 0, 2);
+}
+
+
+/*
+** Advance the cursor n rows without converting any value, so the next
+** fetch returns the row after them. A scroll cursor moves on the server
+** in one fetch. Return false if the cursor ended first; a sequential
+** cursor is closed then, as by fetch.
+*/
+static int cur_skip (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	long n = (long)luaL_checknumber(L, 2);
+	double start;
+	int code = 0;
+
+	luaL_argcheck(L, n >= 0, 2, "row count must not be negative");
+	if (n == 0) {
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+	set_conn(L, conn);
+	start = FETCH_CLOCK();
+	if (cur->scroll) {
+		code = fetch_at(cur, conn, FETCH_RELATIVE, n);
+		FETCH_DONE(conn, start, 0);
+	}
+	else {
+		while ((n-- > 0) && ((code = fetch_row(cur, conn)) == 0))
+			;
+		FETCH_DONE(conn, start, 0);
+		if (code != 0)
+			cur_nullify(L, cur);
+	}
+	if (code == 100) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	if (code != 0) {
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+		return 2;
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Get up to n rows of the given cursor as an array of row tables,
+** laid out by opts as in fetch ('n' by default).
+** A batch shorter than n is the last one, the cursor is closed then.
+*/
+static int cur_fetchmany (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	int n = (int)luaL_checkinteger(L, 2);
+	int mode = rowmode(luaL_optstring(L, 3, "n"));
+	int ncols = cur->cur_sqlda->sqld;
+	size_t bytes = 0;
+	double start;
+	int i, rows;
+
+	luaL_argcheck(L, n > 0, 2, "row count must be positive");
+	if ((mode & ROW_ALPHA) && (cur->colnames == LUA_NOREF))
+		create_colinfo(L, cur);
+	set_conn(L, conn);
+	lua_createtable(L, n, 0);
+	rows = lua_gettop(L);
+	start = FETCH_CLOCK();
+	for (i = 1; i <= n; i++) {
+		if (fetch_row(cur, conn) != 0) {
+			FETCH_DONE(conn, start, bytes);
+			cur_nullify(L, cur);
+			if (conn->conn_sqlca.sqlcode == 100)
+				return 1;
+			lua_pushnil(L);
+			pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+			return 2;
+		}
+		lua_createtable(L, (mode & ROW_NUM) ? ncols : 0, (mode & ROW_ALPHA) ? ncols : 0);
+		bytes += setrow(L, cur, rows + 1, mode);
+		lua_rawseti(L, rows, i);
+	}
+	FETCH_DONE(conn, start, bytes);
+	return 1;
+}
+
+
+/*
+** Get the remaining rows of the given cursor as an array of row tables.
+** opts fields: max_rows and max_bytes stop the fetch once reached,
+** mode lays out rows as in fetch ('n' by default).
+** Return the rows and true if the cursor is drained and closed, or
+** false if it stopped at a limit and stays open for further fetches.
+*/
+static int cur_fetchall (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	int max_rows = getoptint(L, 2, "max_rows", 0);
+	int max_bytes = getoptint(L, 2, "max_bytes", 0);
+	int mode = ROW_NUM;
+	int ncols = cur->cur_sqlda->sqld;
+	int nrec = 0, nhash = 0;
+	size_t bytes = 0;
+	double start;
+	int i, rows;
+
+	if (lua_istable(L, 2)) {
+		lua_getfield(L, 2, "mode");
+		if (lua_isstring(L, -1))
+			mode = rowmode(lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+	luaL_argcheck(L, (max_rows >= 0) && (max_bytes >= 0), 2, "limits must be non-negative");
+	if ((mode & ROW_ALPHA) && (cur->colnames == LUA_NOREF))
+		create_colinfo(L, cur);
+	if (mode & ROW_NUM)
+		nrec = ncols;
+	if (mode & ROW_ALPHA)
+		nhash = ncols;
+	set_conn(L, conn);
+	lua_createtable(L, ((max_rows > 0) && (max_rows < 4096)) ? max_rows : 64, 0);
+	rows = lua_gettop(L);
+	start = FETCH_CLOCK();
+	for (i = 1; (max_rows == 0) || (i <= max_rows); i++) {
+		if ((max_bytes > 0) && (bytes >= (size_t)max_bytes))
+			break;
+		if (fetch_row(cur, conn) != 0) {
+			FETCH_DONE(conn, start, bytes);
+			cur_nullify(L, cur);
+			if (conn->conn_sqlca.sqlcode == 100) {
+				lua_pushboolean(L, 1);
+				return 2;
+			}
+			lua_pushnil(L);
+			pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+			return 2;
+		}
+		lua_createtable(L, nrec, nhash);
+		bytes += setrow(L, cur, rows + 1, mode);
+		lua_rawseti(L, rows, i);
+	}
+	FETCH_DONE(conn, start, bytes);
+	lua_pushboolean(L, 0);
+	return 2;
+}
+
+
+/*
+** The iterator of cursor
+*/
+static int cur_iterator (lua_State *L) {
+	int i;
+
+	lua_pop(L, 1);
+	for (i = 1; !lua_isnone(L, lua_upvalueindex(i)); i++) {
+		lua_pushvalue(L, lua_upvalueindex(i));
+	}
+	return cur_fetch(L);
+}
+
+
+/*
+** Return the iterator of cursor
+*/
+static int cur_getiter (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	const int num = lua_gettop(L) - 1;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		lua_pushvalue(L, i + 2);		/* push fetch parameter as upvalue */
+	}
+	lua_pushcclosure(L, cur_iterator, num);
+	lua_pushvalue(L, 1);				/* push cursor data*/
+	return 2;
+}
+
+
+/*
+** Cursor object collector function
+*/
+static int cur_gc (lua_State *L) {
+	cur_data *cur = (cur_data *)luaL_checkudata(L, 1, LUASQL_CURSOR_INFORMIX);
+	if (cur != NULL && !(cur->closed))
+		cur_nullify(L, cur);
+	return 0;
+}
+
+
+/*
+** Close the cursor on top of the stack.
+** Return 1
+*/
+static int cur_close (lua_State *L) {
+	cur_data *cur = (cur_data *)luaL_checkudata(L, 1, LUASQL_CURSOR_INFORMIX);
+	luaL_argcheck(L, cur != NULL, 1, LUASQL_PREFIX"cursor expected");
+	if (cur->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	cur_nullify(L, cur);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Pushes a column information table on top of the stack.
+** If the table isn't built yet, call the creator function and stores
+** a reference to it on the cursor structure.
+*/
+static void _pushtable (lua_State *L, cur_data *cur, size_t off) {
+	int *ref = (int *)((char *)cur + off);
+
+	/* If colnames or coltypes do not exist, create both. */
+	if (*ref == LUA_NOREF)
+		create_colinfo(L, cur);
+	
+	/* Pushes the right table (colnames or coltypes) */
+	lua_rawgeti (L, LUA_REGISTRYINDEX, *ref);
+}
+#define pushtable(L,c,m) (_pushtable(L,c,offsetof(cur_data,m)))
+
+
+/*
+** Return the list of field names.
+*/
+static int cur_getcolnames (lua_State *L) {
+	pushtable(L, getcursor(L), colnames);
+	return 1;
+}
+
+
+/*
+** Return the list of field types.
+*/
+static int cur_getcoltypes (lua_State *L) {
+	pushtable(L, getcursor(L), coltypes);
+	return 1;
+}
+
+
+/*
+** Return the field num.
+*/
+static int cur_getfieldnum (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	lua_pushinteger(L, cur->cur_sqlda->sqld);
+	return 1;
+}
+
+
+/*
+** Change a fetch option of the cursor, for the rows not fetched yet.
+*/
+static int cur_setoption (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	fetch_opts opts = cur->opts;
+	ifx_sqlvar_t *sqlvar;
+	int i;
+
+	/* the fetch buffer layout depends on lob */
+	if (setoption(L, &opts, 2) == OPT_LOB)
+		luaL_argerror(L, 2, "lob must be set on the connection");
+	cur->opts = opts;
+	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
+		cur->decoders[i] = getdecoder(sqlvar->sqltype, &(cur->opts));
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Get up to n rows of the given cursor as one array per column, keyed
+** by the column names. NULL values are set to the sentinel if one is
+** given, otherwise they are left as holes.
+** Return the column table, the number of rows and a table keyed by the
+** names of the columns with NULL values, holding true at their rows.
+** A batch shorter than n is the last one, the cursor is closed then.
+*/
+static int cur_fetchcolumns (lua_State *L) {
+	cur_data *cur = getcursor(L);
+	conn_data *conn = getconnfromref(L, cur->conn);
+	int n = (int)luaL_checkinteger(L, 2);
+	int has_sentinel = !lua_isnoneornil(L, 3);
+	int ncols = cur->cur_sqlda->sqld;
+	int names, cols, nulls, row, i;
+	ifx_sqlvar_t *sqlvar = NULL;
+	size_t bytes = 0;
+	double start;
+
+	luaL_argcheck(L, n > 0, 2, "row count must be positive");
+	lua_settop(L, 3);
+	pushtable(L, cur, colnames);
+	names = lua_gettop(L);
+	luaL_checkstack(L, 2 * ncols + 4, LUASQL_PREFIX"too many columns");
+	cols = names + 1;
+	for (i = 0; i < ncols; i++)
+		lua_createtable(L, n, 0);
+	nulls = cols + ncols;
+	for (i = 0; i < ncols; i++)
+		lua_pushnil(L);			/* null tables are created on demand */
+
+	set_conn(L, conn);
+	start = FETCH_CLOCK();
+	for (row = 1; row <= n; row++) {
+		if (fetch_row(cur, conn) != 0) {
+			FETCH_DONE(conn, start, bytes);
+			cur_nullify(L, cur);
+			if (conn->conn_sqlca.sqlcode == 100)
+				break;
+			lua_pushnil(L);
+			pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
+			return 2;
+		}
+		for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < ncols; i++, sqlvar++) {
+			if (*(sqlvar->sqlind) == -1) {
+				if (lua_isnil(L, nulls + i)) {
+					lua_newtable(L);
+					lua_replace(L, nulls + i);
+				}
+				lua_pushboolean(L, 1);
+				lua_rawseti(L, nulls + i, row);
+				if (!has_sentinel)
+					continue;
+				lua_pushvalue(L, 3);
+			}
+			else {
+				cur->decoders[i](L, cur, sqlvar);
+				bytes += valuebytes(L);
+			}
+			lua_rawseti(L, cols + i, row);
+		}
+	}
+	if (!cur->closed)
+		FETCH_DONE(conn, start, bytes);	/* timed above at the end */
+
+	lua_createtable(L, 0, ncols);			/* columns */
+	lua_newtable(L);						/* nulls */
+	for (i = 0; i < ncols; i++) {
+		lua_rawgeti(L, names, i + 1);
+		lua_pushvalue(L, cols + i);
+		lua_rawset(L, -4);
+		if (!lua_isnil(L, nulls + i)) {
+			lua_rawgeti(L, names, i + 1);
+			lua_pushvalue(L, nulls + i);
+			lua_rawset(L, -3);
+		}
+	}
+	lua_pushinteger(L, row - 1);
+	lua_insert(L, -2);
+	return 3;
+}
+
+
+/*
+** Check for valid large object handle.
+*/
+static lob_data *getlob (lua_State *L) {
+	lob_data *lob = (lob_data *)luaL_checkudata(L, 1, LUASQL_LOB_INFORMIX);
+	luaL_argcheck(L, lob != NULL, 1, "lob expected");
+	luaL_argcheck(L, !lob->closed, 1, "lob is closed");
+	return lob;
+}
+
+
+/*
+** Push error message of a failed smart large object call
+*/
+static int lob_fail (lua_State *L, const char *hint, mint err) {
+	lua_pushnil(L);
+	lua_pushfstring(L, "%s fail, CODE:%d", hint, (int)err);
+	return 2;
+}
+
+
+/*
+** Make the connection of the handle current and open the object for
+** reading on first use. Return 0 or the error code.
+*/
+static mint lob_open (lua_State *L, lob_data *lob) {
+	conn_data *conn = getconnfromref(L, lob->conn);
+	mint err = 0;
+
+	if (conn->closed)
+		return -1803;
+	set_conn(L, conn);
+	if (lob->fd < 0) {
+		lob->fd = ifx_lo_open(&(lob->lo), LO_RDONLY, &err);
+		if (lob->fd < 0)
+			return (err != 0) ? err : lob->fd;
+	}
+	return 0;
+}
+
+
+/*
+** Read up to n bytes into the buffer of the handle.
+** Return the bytes read, 0 at the end, or -1 with the error in *err.
+*/
+static mint lob_fill (lua_State *L, lob_data *lob, int n, mint *err) {
+	mint r;
+
+	if ((*err = lob_open(L, lob)) != 0)
+		return -1;
+	if (n > lob->bufsize) {
+		char *buf = (char *)realloc(lob->buf, n);
+		if (buf == NULL) {
+			*err = -208;
+			return -1;
+		}
+		lob->buf = buf;
+		lob->bufsize = n;
+	}
+	r = ifx_lo_read(lob->fd, lob->buf, n, err);
+	return (r < 0) ? -1 : r;
+}
+
+
+/*
+** Read the next chunk, at most n bytes (64K by default).
+** Return nil at the end of the object.
+*/
+static int lob_read (lua_State *L) {
+	lob_data *lob = getlob(L);
+	int n = (int)luaL_optinteger(L, 2, LOB_CHUNK_SIZE);
+	mint err, r;
+
+	luaL_argcheck(L, n > 0, 2, "chunk size must be positive");
+	r = lob_fill(L, lob, n, &err);
+	if (r < 0)
+		return lob_fail(L, "read lob", err);
+	if (r == 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushlstring(L, lob->buf, r);
+	return 1;
+}
+
+
+/*
+** The chunk iterator of lob
+*/
+static int lob_iterator (lua_State *L) {
+	lua_settop(L, 0);
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_pushvalue(L, lua_upvalueindex(2));
+	return lob_read(L);
+}
+
+
+/*
+** Return an iterator over the chunks of the object: for s in lob:chunks(n)
+*/
+static int lob_chunks (lua_State *L) {
+	getlob(L);
+	luaL_argcheck(L, luaL_optinteger(L, 2, LOB_CHUNK_SIZE) > 0, 2, "chunk size must be positive");
+	lua_settop(L, 2);
+	if (lua_isnil(L, 2)) {
+		lua_pushinteger(L, LOB_CHUNK_SIZE);
+		lua_replace(L, 2);
+	}
+	lua_pushcclosure(L, lob_iterator, 2);
+	return 1;
+}
+
+
+/*
+** Write the rest of the object to a file descriptor, or to the file at
+** the given path. Return the number of bytes written.
+*/
+static int lob_writeto (lua_State *L) {
+	lob_data *lob = getlob(L);
+	int n = (int)luaL_optinteger(L, 3, LOB_CHUNK_SIZE);
+	int fd, own = 0;
+	double total = 0;
+	mint err, r;
+
+	luaL_argcheck(L, n > 0, 3, "chunk size must be positive");
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		fd = (int)lua_tointeger(L, 2);
+	}
+	else {
+		fd = open(luaL_checkstring(L, 2), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0)
+			return luasql_faildirect(L, strerror(errno));
+		own = 1;
+	}
+	while ((r = lob_fill(L, lob, n, &err)) > 0) {
+		char *p = lob->buf;
+		while (r > 0) {
+			ssize_t w = write(fd, p, r);
+			if (w < 0) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				if (own)
+					close(fd);
+				return luasql_faildirect(L, strerror(err));
+			}
+			p += w;
+			r -= w;
+			total += w;
+		}
+	}
+	if (own)
+		close(fd);
+	if (r < 0)
+		return lob_fail(L, "read lob", err);
+	lua_pushnumber(L, total);
+	return 1;
+}
+
+
+/*
+** Return the size of the object in bytes.
+*/
+static int lob_size (lua_State *L) {
+	lob_data *lob = getlob(L);
+	ifx_lo_stat_t *stat = NULL;
+	ifx_int8_t size;
+	bigint b;
+	mint err;
+
+	if ((err = lob_open(L, lob)) != 0)
+		return lob_fail(L, "open lob", err);
+	if ((err = ifx_lo_stat(lob->fd, &stat)) < 0)
+		return lob_fail(L, "stat lob", err);
+	err = ifx_lo_stat_size(stat, &size);
+	ifx_lo_stat_free(stat);
+	if ((err < 0) || (bigintcvifx_int8(&size, &b) != 0))
+		return lob_fail(L, "stat lob", err);
+	lua_pushnumber(L, (lua_Number)b);
+	return 1;
+}
+
+
+/*
+** Close the object and release the handle.
+*/
+static void lob_nullify (lua_State *L, lob_data *lob) {
+	conn_data *conn = getconnfromref(L, lob->conn);
+
+	if ((lob->fd >= 0) && !(conn->closed)) {
+		set_conn(L, conn);
+		ifx_lo_close(lob->fd);
+	}
+	lob->closed = 1;
+	lob->fd = -1;
+	free(lob->buf);
+	lob->buf = NULL;
+	luaL_unref(L, LUA_REGISTRYINDEX, lob->conn);
+}
+
+
+/*
+** Lob object collector function
+*/
+static int lob_gc (lua_State *L) {
+	lob_data *lob = (lob_data *)luaL_checkudata(L, 1, LUASQL_LOB_INFORMIX);
+	if (lob != NULL && !(lob->closed))
+		lob_nullify(L, lob);
+	return 0;
+}
+
+
+/*
+** Close the lob handle.
+*/
+static int lob_close (lua_State *L) {
+	lob_data *lob = (lob_data *)luaL_checkudata(L, 1, LUASQL_LOB_INFORMIX);
+	luaL_argcheck(L, lob != NULL, 1, LUASQL_PREFIX"lob expected");
+	if (lob->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	lob_nullify(L, lob);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Offsets of the parts of a cursor arena.
+*/
+typedef struct {
+	size_t	size;
+	size_t	dec_off;			/* decoders */
+	size_t	ind_off;			/* indicators */
+	size_t	buf_off;			/* fetch buffer */
+} arena_layout;
+
+
+/*
+** Create a new Cursor object over an arena set up by arena_init and
+** push it on top of the stack. curid is NULL for a replayed cursor.
+*/
+static int create_cursor (lua_State *L, int conn, char *curid, char *arena, const arena_layout *layout) {
+	ifx_sqlvar_t *sqlvar = NULL;
+	ifx_sqlda_t *sqlda = (ifx_sqlda_t *)arena;
+	int i;
+	cur_data *cur = (cur_data *)lua_newuserdata(L, sizeof(cur_data));
+	luasql_setmeta(L, LUASQL_CURSOR_INFORMIX);
+
+	/* fill in structure */
+	cur->closed = 0;
+	cur->conn = LUA_NOREF;
+	cur->colnames = LUA_NOREF;
+	cur->coltypes = LUA_NOREF;
+	if (curid != NULL) {
+		strncpy(cur->cur_name,curid,sizeof(cur->cur_name));
+		cur->curs = sqli_curs_locate(ESQLINTVERSION, curid, 768);
+	}
+	else {
+		cur->cur_name[0] = '\0';
+		cur->curs = NULL;
+	}
+	cur->arena = arena;
+	cur->arena_size = layout->size;
+	cur->cur_sqlda = sqlda;
+	cur->buf = arena + layout->buf_off;
+	cur->indicators = (int2 *)(arena + layout->ind_off);
+	cur->decoders = (col_decoder *)(arena + layout->dec_off);
+	cur->opts = ((conn_data *)lua_touserdata(L, conn))->opts;
+	cur->scroll = 0;
+	cur->sql = LUA_NOREF;
+	cur->started = 0;
+	cur->rows = 0;
+	cur->sqlcode = 0;
+	cur->trace_id = 0;
+	cur->replay = NULL;
+	cur->replay_obj = LUA_NOREF;
+	cur->replay_pos = 0;
+	cur->capture = NULL;
+	cur->result = NULL;
+	cur->result_pos = NULL;
+	cur->result_left = 0;
+	cur->generation = ((conn_data *)lua_touserdata(L, conn))->generation;
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
+		cur->decoders[i] = getdecoder(sqlvar->sqltype, &(cur->opts));
+	}
+	lua_pushvalue (L, conn);
+	cur->conn = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	return 1;
+}
+
+
+/*
+** Hash of the SQL text (FNV-1a).
+*/
+static unsigned int sql_hash (const char *sql, size_t len) {
+	unsigned int h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)sql[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+/*
+** Free a prepared statement and everything it owns.
+** The connection must be current, unless the statement handle went
+** with a closed connection (entry->stmt is NULL).
+*/
+static void stmt_free (lua_State *L, stmt_entry *entry) {
+	if (entry->stmt != NULL)
+		sqli_curs_free(ESQLINTVERSION, entry->stmt);
+	if (entry->sqlda != NULL)
+		free(entry->sqlda);
+	luaL_unref(L, LUA_REGISTRYINDEX, entry->colnames);
+	luaL_unref(L, LUA_REGISTRYINDEX, entry->coltypes);
+	free(entry);
+}
+
+
+/*
+** Unlink an entry from the hash bucket and the LRU list.
+*/
+static void stmt_cache_unlink (stmt_cache *cache, stmt_entry *entry) {
+	stmt_entry **pp = &(cache->buckets[entry->hash & (cache->nbuckets - 1)]);
+
+	while (*pp != entry)
+		pp = &((*pp)->hnext);
+	*pp = entry->hnext;
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+	entry->hnext = entry->prev = entry->next = NULL;
+	entry->cached = 0;
+	cache->count--;
+}
+
+
+/*
+** Move an entry to the front of the LRU list.
+*/
+static void stmt_cache_touch (stmt_cache *cache, stmt_entry *entry) {
+	if (cache->head == entry)
+		return;
+	entry->prev->next = entry->next;
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+	entry->prev = NULL;
+	entry->next = cache->head;
+	cache->head->prev = entry;
+	cache->head = entry;
+}
+
+
+/*
+** Free all cached statements.
+** The connection must be current.
+*/
+static void stmt_cache_flush (lua_State *L, stmt_cache *cache) {
+	stmt_entry *entry = cache->head;
+
+	while (entry != NULL) {
+		stmt_entry *next = entry->next;
+		stmt_free(L, entry);
+		entry = next;
+	}
+	if (cache->buckets != NULL)
+		memset(cache->buckets, 0, cache->nbuckets * sizeof(stmt_entry *));
+	cache->head = cache->tail = NULL;
+	cache->count = 0;
+}
+
+
+/*
+** Resize the statement cache, evicting the least recently used entries.
+** The connection must be current.
+*/
+static int stmt_cache_resize (lua_State *L, stmt_cache *cache, int size) {
+	stmt_entry **buckets = NULL;
+	stmt_entry *entry;
+	int nbuckets = 1;
+
+	while (cache->count > size) {
+		entry = cache->tail;
+		stmt_cache_unlink(cache, entry);
+		stmt_free(L, entry);
+		cache->evictions++;
+	}
+	if (size > 0) {
+		while (nbuckets < size)
+			nbuckets <<= 1;
+		buckets = (stmt_entry **)calloc(nbuckets, sizeof(stmt_entry *));
+		if (buckets == NULL)
+			return -1;
+		/* rehash remaining entries */
+		for (entry = cache->head; entry != NULL; entry = entry->next) {
+			stmt_entry **b = &(buckets[entry->hash & (nbuckets - 1)]);
+			entry->hnext = *b;
+			*b = entry;
+		}
+	}
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->nbuckets = (buckets != NULL) ? nbuckets : 0;
+	cache->size = size;
+	return 0;
+}
+
+
+/*
+** Find the prepared statement of the SQL text, prepare and describe
+** it on a cache miss. Returns NULL if the prepare fails.
+** The connection must be current.
+*/
+static stmt_entry *stmt_prepare (lua_State *L, conn_data *conn, const char *sql, size_t len, int use_cache) {
+	stmt_cache *cache = &(conn->cache);
+	unsigned int hash = sql_hash(sql, len);
+	stmt_entry *entry;
+	char prepid[64];
+	double start;
+
+	if (!use_cache)
+		cache = NULL;
+	if ((cache != NULL) && (cache->size > 0)) {
+		for (entry = cache->buckets[hash & (cache->nbuckets - 1)]; entry != NULL; entry = entry->hnext) {
+			if ((entry->hash == hash) && (entry->sql_len == len) && (memcmp(entry->sql, sql, len) == 0)) {
+				stmt_cache_touch(cache, entry);
+				cache->hits++;
+				return entry;
+			}
+		}
+		cache->misses++;
+	}
+
+	snprintf(prepid, sizeof(prepid), "p_%lX_%d", (unsigned long)(uintptr_t)conn, conn->stmt_cnt);
+	entry = (stmt_entry *)malloc(sizeof(stmt_entry) + len + 1);
+	if (entry == NULL) {
+		memset(&(conn->conn_sqlca), 0, sizeof(ifx_sqlca_t));
+		conn->conn_sqlca.sqlcode = -208;	/* memory allocation failed */
+		return NULL;
+	}
+	memset(entry, 0, sizeof(stmt_entry));
+	entry->hash = hash;
+	entry->sql_len = len;
+	entry->sql = (char *)(entry + 1);
+	memcpy(entry->sql, sql, len);
+	entry->sql[len] = '\0';
+	entry->colnames = LUA_NOREF;
+	entry->coltypes = LUA_NOREF;
+
+	start = now_seconds();
+	entry->stmt = sqli_prep(ESQLINTVERSION, prepid, entry->sql, (ifx_literal_t *)0, (ifx_namelist_t *)0, -1, 0, 0 );
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	stat_time(conn->timing, STAT_PREPARE, start);
+	if (sqlca.sqlcode != 0) {
+		free(entry);
+		return NULL;
+	}
+	start = now_seconds();
+	sqli_describe_stmt(ESQLINTVERSION, entry->stmt, &(entry->sqlda), 0);
+	stat_time(conn->timing, STAT_DESCRIBE, start);
+	if (entry->sqlda->sqld == 0) {
+		free(entry->sqlda);
+		entry->sqlda = NULL;
+	}
+
+	if ((cache != NULL) && (cache->size > 0)) {
+		stmt_entry **b = &(cache->buckets[hash & (cache->nbuckets - 1)]);
+		if (cache->count >= cache->size) {
+			stmt_entry *old = cache->tail;
+			stmt_cache_unlink(cache, old);
+			stmt_free(L, old);
+			cache->evictions++;
+		}
+		entry->hnext = *b;
+		*b = entry;
+		entry->next = cache->head;
+		if (cache->head != NULL)
+			cache->head->prev = entry;
+		else
+			cache->tail = entry;
+		cache->head = entry;
+		entry->cached = 1;
+		cache->count++;
+	}
+	return entry;
+}
+
+
+/*
+** Free a statement got from stmt_prepare unless the cache keeps it.
+*/
+static void stmt_release (lua_State *L, stmt_entry *entry) {
+	if (!(entry->cached) && !(entry->keep))
+		stmt_free(L, entry);
+}
+
+
+/*
+** Create a new reference to the value referenced by ref.
+*/
+static int copyref (lua_State *L, int ref) {
+	if (ref == LUA_NOREF)
+		return LUA_NOREF;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+	return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+
+static int async_ready (struct async_data *a, int ms);
+
+
+/*
+** Close the ESQL/C connection and give its pool slot back.
+*/
+static void conn_nullify (lua_State *L, conn_data *conn) {
+	pool_data *pool;
+	conn_data **p;
+
+	if (conn->async != NULL)
+		async_ready(conn->async, -1);
+	set_conn(L, conn);
+	stmt_cache_flush(L, &(conn->cache));
+	free(conn->cache.buckets);
+	conn->cache.buckets = NULL;
+	arena_flush(conn);
+	trace_close(conn);
+	sqli_trans_rollback();
+	result_txn_end(L, conn);
+	sqli_connect_close(0, conn->conn_name, 0, 0);
+	active_conn = NULL;
+
+	/* Nullify structure fields. */
+	conn->closed = 1;
+	LOCK_CONN_LIST();
+	for (p = &conn_list; *p != NULL; p = &((*p)->list_next)) {
+		if (*p == conn) {
+			*p = conn->list_next;
+			break;
+		}
+	}
+	UNLOCK_CONN_LIST();
+	stats_add(&(conn->envp->closed_stats), &(conn->stats));
+	luaL_unref(L, LUA_REGISTRYINDEX, conn->env);
+	luaL_unref(L, LUA_REGISTRYINDEX, conn->hook);
+	conn->hook = LUA_NOREF;
+	if (conn->pool != LUA_NOREF) {
+		pool = getpoolfromref(L, conn->pool);
+		if (!conn->pool_idle)
+			pool->busy--;
+		pool->closed_cnt++;
+		luaL_unref(L, LUA_REGISTRYINDEX, conn->pool);
+		conn->pool = LUA_NOREF;
+	}
+}
+
+
+static int conn_gc (lua_State *L) {
+	conn_data *conn=(conn_data *)luaL_checkudata(L, 1, LUASQL_CONNECTION_INFORMIX);
+	if (conn != NULL && !(conn->closed))
+		conn_nullify(L, conn);
+	return 0;
+}
+
+
+/*
+** Close a Connection object.
+*/
+static int conn_close (lua_State *L) {
+	conn_data *conn=(conn_data *)luaL_checkudata(L, 1, LUASQL_CONNECTION_INFORMIX);
+	luaL_argcheck(L, conn != NULL, 1, LUASQL_PREFIX"connection expected");
+	if (conn->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	conn_gc(L);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Make the connection dormant, so the Lua state owning it can go on in
+** another OS thread. The next use makes it current in that thread.
+** A connection busy with an asynchronous call is dormant already.
+*/
+static int make_dormant (conn_data *conn) {
+	if (conn != active_conn)
+		return 0;
+	sqli_connect_set(0, conn->conn_name, 1);
+	memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
+	active_conn = NULL;
+	return sqlca.sqlcode;
+}
+
+static int conn_detach (lua_State *L) {
+	conn_data *conn = getconnection(L);
+
+	if (conn->async == NULL) {
+		if (make_dormant(conn) != 0) {
+			lua_pushboolean(L, 0);
+			pusherrmsg(L, &(conn->conn_sqlca), "set connection dormant");
+			return 2;
+		}
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Set the timeout in seconds of each later call, 0 for none.
+*/
+static int conn_settimeout (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	double timeout = luaL_checknumber(L, 2);
+	luaL_argcheck(L, timeout >= 0, 2, "timeout must not be negative");
+	conn->timeout = timeout;
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Interrupt the running call of the connection, e.g. of execute_async.
+** Only raises a flag break_callback checks, so it may be done from a
+** signal handler too.
+*/
+static int conn_cancel (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	conn->cancel = 1;
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Process wide name of the connection, for luasql.cancel.
+*/
+static int conn_getid (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	lua_pushstring(L, conn->conn_name);
+	return 1;
+}
+
+
+/*
+** Interrupt the running call of the connection named id, which may be
+** driven by a Lua state of another thread.
+** luasql.cancel(id)
+*/
+static int driver_cancel (lua_State *L) {
+	const char *id = luaL_checkstring(L, 1);
+	conn_data *conn;
+	int found = 0;
+
+	LOCK_CONN_LIST();
+	for (conn = conn_list; conn != NULL; conn = conn->list_next) {
+		if (strcmp(conn->conn_name, id) == 0) {
+			conn->cancel = 1;
+			found = 1;
+			break;
+		}
+	}
+	UNLOCK_CONN_LIST();
+	lua_pushboolean(L, found);
+	return 1;
+}
+
+
+/*
+** C type and length a described column is fetched as.
+*/
+static void fetch_type (ifx_sqlvar_t *sqlvar, const fetch_opts *opts, int2 *p_type, int4 *p_len) {
+	int c = sqlvar->sqltype;
+	int2 type = sqlvar->sqltype;
+	int4 len = sqlvar->sqllen;
+
+	toctype(sqlvar->sqltype, c);
+
+	/* deal UDT type */
+	if (ISUDTTYPE(c)) {
+		switch(sqlvar->sqlxid) {
+			case XID_BLOB:
+			case XID_CLOB:
+				if (opts->lob) {
+					/* fetch the handle only, read by lob methods */
+					type = SQLUDTFIXED;
+					len = sizeof(ifx_lo_t);
+					break;
+				}
+				type = CLOCATORTYPE;
+				len = sizeof(ifx_loc_t);
+				break;
+			default:
+				/* text of the value: a variable UDT is at most its described
+				   length, a fixed one gets room for a hex or decimal form */
+				type = CSTRINGTYPE;
+				if (len <= 0)
+					len = UDT_TEXT_SIZE;
+				else if (c == SQLUDTVAR)
+					len = len + 1;
+				else
+					len = 2 * len + 32;
+		}
+	}
+
+	/* SQLLVARCHAR convert to c style string type CSTRINGTYPE */
+	if (c == SQLLVARCHAR)
+		type = CSTRINGTYPE;
+
+	/* fetch INT8 and SERIAL8 as native 64-bit integers */
+	if (type == CINT8TYPE)
+		type = CBIGINTTYPE;
+
+	*p_type = type;
+	*p_len = len;
+}
+
+
+/* cursor arena parts start at multiples of this */
+#define ARENA_ALIGN(n)	(((n) + 15) & ~(size_t)15)
+
+/*
+** Compute the layout of the arena of a cursor over the described
+** columns: a copy of the sqlda with the column names, the decoders,
+** the indicators and the fetch buffer. Queries of the same shape get
+** the same size, which keys the arena pool.
+*/
+static void arena_size (ifx_sqlda_t *src, const fetch_opts *opts, arena_layout *layout) {
+	size_t size = sizeof(ifx_sqlda_t) + src->sqld * sizeof(ifx_sqlvar_t);
+	ifx_sqlvar_t *sqlvar;
+	mlong len = 0;
+	int2 type;
+	int4 tlen;
+	int i;
+
+	for (i = 0, sqlvar = src->sqlvar; i < src->sqld; i++, sqlvar++) {
+		size += strlen(sqlvar->sqlname) + 1;
+		fetch_type(sqlvar, opts, &type, &tlen);
+		len = rtypalign(len, type) + rtypmsize(type, tlen);
+	}
+	layout->dec_off = ARENA_ALIGN(size);
+	layout->ind_off = ARENA_ALIGN(layout->dec_off + src->sqld * sizeof(col_decoder));
+	layout->buf_off = ARENA_ALIGN(layout->ind_off + src->sqld * sizeof(int2));
+	layout->size = layout->buf_off + len + 1;
+}
+
+
+/*
+** Copy the described sqlda into the arena and bind its columns to the
+** fetch buffer of the arena.
+*/
+static void arena_init (char *arena, ifx_sqlda_t *src, const fetch_opts *opts, const arena_layout *layout) {
+	ifx_sqlda_t *sqlda = (ifx_sqlda_t *)arena;
+	ifx_sqlvar_t *sqlvar = NULL;
+	int2 *ind = (int2 *)(arena + layout->ind_off);
+	char *buf = arena + layout->buf_off, *p;
+	int i;
+
+	memcpy(sqlda, src, sizeof(ifx_sqlda_t));
+	sqlda->sqlvar = (ifx_sqlvar_t *)(sqlda + 1);
+	memcpy(sqlda->sqlvar, src->sqlvar, src->sqld * sizeof(ifx_sqlvar_t));
+	p = (char *)(sqlda->sqlvar + src->sqld);
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
+		size_t len = strlen(sqlvar->sqlname) + 1;
+		memcpy(p, sqlvar->sqlname, len);
+		sqlvar->sqlname = p;
+		p += len;
+	}
+
+	memset(ind, 0, layout->size - layout->ind_off);
+	for (i = 0, sqlvar = sqlda->sqlvar, p = buf; i < sqlda->sqld; i++, sqlvar++, ind++) {
+		fetch_type(src->sqlvar + i, opts, &(sqlvar->sqltype), &(sqlvar->sqllen));
+		p = (char *)rtypalign((mlong)p, sqlvar->sqltype);
+		sqlvar->sqldata = p;
+		p += rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
+
+		/* adjust type length except datetime and decimal type */
+		if ((sqlvar->sqltype != CDTIMETYPE)&&
+			(sqlvar->sqltype != CINVTYPE)&&
+			(sqlvar->sqltype != CDECIMALTYPE)&&
+			(sqlvar->sqltype != CMONEYTYPE)) {
+				sqlvar->sqllen=rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
+		}
+
+		/* setup locator type */
+		if (sqlvar->sqltype == CLOCATORTYPE) {
+			ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
+			loc->loc_loctype = LOCMEMORY;
+			loc->loc_bufsize = -1;
+			loc->loc_oflags = 0;
+			loc->loc_mflags = LOC_ALLOC;
+		}
+
+		sqlvar->sqlind = ind;
+	}
+}
+
+
+/*
+** Execute a prepared statement which is not a query.
+** Return the number of tuples affected by the statement.
+*/
+static int exec_stmt (lua_State *L, conn_data *conn, stmt_entry *entry, ifx_sqlda_t *in_sqlda) {
+	double start = now_seconds();
+
+	sqli_exec(ESQLINTVERSION, entry->stmt, in_sqlda, (char *)0, (struct value *)0,
+		(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	stat_time(&(conn->stats), STAT_EXECUTE, start);
+	result_written(L, conn, entry->sql, entry->sql_len);
+	if (sqlca.sqlcode != 0) {
+		/* execute sql fail */
+		lua_pushnil(L);
+	}
+	else {
+		/* return affected rows */
+		lua_pushinteger(L, sqlca.sqlerrd[2]);
+	}
+	pusherrmsg(L, &(conn->conn_sqlca), "execute sql");
+	return 2;
+}
+
+
+/*
+** Declare and open cursor curid for a prepared query, binding in_sqlda
+** to its input parameters, as a SCROLL cursor if scroll is set.
+** Return the failing step, or NULL.
+** Makes no Lua calls, so an asynchronous call can run it in a worker.
+*/
+static const char *curs_open (conn_data *conn, stmt_entry *entry, ifx_sqlda_t *in_sqlda, char *curid, int scroll) {
+	double start = now_seconds();
+
+	/* declare cursor with hold */
+	sqli_curs_decl_dynm(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 512), curid, entry->stmt,
+		scroll ? (CURS_HOLD | CURS_SCROLL) : CURS_HOLD, 0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode != 0)
+		return "declare cursor";
+
+	/* open cursor */
+	sqli_curs_open(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 768),
+		in_sqlda, (char *)0, (struct value *)0, (in_sqlda != NULL), 0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	stat_time(conn->timing, STAT_OPEN, start);
+	if (sqlca.sqlcode != 0) {
+		sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
+		return "open cursor";
+	}
+	return NULL;
+}
+
+
+/*
+** Create the Cursor object of the open cursor curid of a prepared query.
+** The connection object is at index conn_idx.
+*/
+static int wrap_cursor (lua_State *L, int conn_idx, conn_data *conn, stmt_entry *entry, char *curid) {
+	arena_layout layout;
+	char *arena;
+
+	/* one allocation for sqlda, decoders, indicators and fetch buffer */
+	arena_size(entry->sqlda, &(conn->opts), &layout);
+	arena = arena_get(conn, layout.size);
+	if (arena == NULL) {
+		sqli_curs_close(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 768));
+		sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
+		lua_pushnil(L);
+		lua_pushstring(L, "alloc fetch buffer fail");
+		return 2;
+	}
+	arena_init(arena, entry->sqlda, &(conn->opts), &layout);
+
+	create_cursor(L, conn_idx, curid, arena, &layout);
+	if (conn->trace != NULL)
+		trace_describe(L, conn, entry);
+	if (entry->cached || entry->keep) {
+		/* share column information tables with later cursors */
+		cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+		if (entry->colnames == LUA_NOREF) {
+			create_colinfo(L, cur);
+			entry->colnames = copyref(L, cur->colnames);
+			entry->coltypes = copyref(L, cur->coltypes);
+		}
+		else {
+			cur->colnames = copyref(L, entry->colnames);
+			cur->coltypes = copyref(L, entry->coltypes);
+		}
+	}
+	return 1;
+}
+
+
+/*
+** Declare and open a cursor for a prepared query, binding in_sqlda
+** to its input parameters. The connection object is at index conn_idx.
+** Return a Cursor object.
+*/
+static int open_cursor (lua_State *L, int conn_idx, conn_data *conn, stmt_entry *entry, ifx_sqlda_t *in_sqlda, int scroll) {
+	char curid[64];
+	const char *hint;
+
+	snprintf(curid, sizeof(curid), "c_%lX_%d", (unsigned long)(uintptr_t)conn, conn->stmt_cnt);
+	hint = curs_open(conn, entry, in_sqlda, curid, scroll);
+	if (hint != NULL) {
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), (char *)hint);
+		return 2;
+	}
+	if (wrap_cursor(L, conn_idx, conn, entry, curid) != 1)
+		return 2;
+	((cur_data *)lua_touserdata(L, -1))->scroll = scroll;
+	return 1;
+}
+
+
+/*
+** Push a Cursor object over the rows of a cached result. The
+** connection object is at index conn_idx.
+** Return 0 if its arena cannot be allocated.
+*/
+static int result_open (lua_State *L, int conn_idx, conn_data *conn, result_entry *e) {
+	arena_layout layout;
+	cur_data *cur;
+	char *arena;
+
+	arena_size(&(e->sqlda), &(conn->opts), &layout);
+	arena = arena_get(conn, layout.size);
+	if (arena == NULL)
+		return 0;
+	arena_init(arena, &(e->sqlda), &(conn->opts), &layout);
+
+	create_cursor(L, conn_idx, NULL, arena, &layout);
+	cur = (cur_data *)lua_touserdata(L, -1);
+	cur->result = e;
+	cur->result_pos = e->rows;
+	cur->result_left = e->nrows;
+	e->refs++;
+	return 1;
+}
+
+
+/*
+** Look up a query of the connection at index conn_idx in the result
+** cache of its environment, with the parameter values at indices first
+** to last. On a hit push a Cursor object over the cached rows and
+** return 1. On a miss push the key to cache its result under and
+** return 0. Return -1, pushing nothing, if the query is not cached:
+** the cache is disabled, the connection wrote in its transaction, the
+** values would not be plain ones or the statement is not a SELECT
+** reading tables.
+*/
+static int result_lookup (lua_State *L, int conn_idx, conn_data *conn, const char *sql, size_t len, int first, int last) {
+	result_cache *cache = &(conn->envp->cache);
+	char tables[RESULT_TABLES_SIZE];
+	luaL_Buffer b;
+	const char *key, *str;
+	size_t key_len, l;
+	result_entry *e;
+	lua_Number d;
+	int i;
+
+	if (cache->max_bytes == 0)
+		return -1;
+	if ((conn->written != LUA_NOREF) || conn->opts.lob
+	  || (sql_read_tables(sql, len, tables, sizeof(tables)) == 0)) {
+		cache->bypasses++;
+		return -1;
+	}
+	luaL_buffinit(L, &b);
+	luaL_addstring(&b, conn->dbkey);
+	luaL_addchar(&b, '\0');
+	luaL_addlstring(&b, sql, len);
+	luaL_addchar(&b, '\0');
+	for (i = first; i <= last; i++) {
+		switch (lua_type(L, i)) {
+			case LUA_TBOOLEAN:
+				luaL_addchar(&b, lua_toboolean(L, i) ? 'T' : 'F');
+				break;
+			case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+				if (lua_isinteger(L, i)) {
+					lua_Integer n = lua_tointeger(L, i);
+					luaL_addchar(&b, 'i');
+					luaL_addlstring(&b, (const char *)&n, sizeof(lua_Integer));
+					break;
+				}
+#endif
+				d = lua_tonumber(L, i);
+				luaL_addchar(&b, 'n');
+				luaL_addlstring(&b, (const char *)&d, sizeof(lua_Number));
+				break;
+			case LUA_TSTRING:
+				str = lua_tolstring(L, i, &l);
+				luaL_addchar(&b, 's');
+				luaL_addlstring(&b, (const char *)&l, sizeof(size_t));
+				luaL_addlstring(&b, str, l);
+				break;
+			default:
+				luaL_addchar(&b, 'z');
+		}
+	}
+	luaL_pushresult(&b);
+
+	key = lua_tolstring(L, -1, &key_len);
+	e = result_find(cache, key, key_len, sql_hash(key, key_len));
+	if ((e != NULL) && (e->expires <= now_seconds())) {
+		result_remove(cache, e);
+		cache->expirations++;
+		e = NULL;
+	}
+	if (e == NULL) {
+		cache->misses++;
+		conn->stats.result_misses++;
+		return 0;
+	}
+	if (!result_open(L, conn_idx, conn, e)) {
+		lua_pop(L, 1);
+		return -1;
+	}
+	lua_remove(L, -2);			/* key */
+	cache->hits++;
+	conn->stats.result_hits++;
+	if (e != cache->head) {
+		/* move to the front of the LRU list */
+		e->prev->next = e->next;
+		if (e->next != NULL)
+			e->next->prev = e->prev;
+		else
+			cache->tail = e->prev;
+		e->prev = NULL;
+		e->next = cache->head;
+		cache->head->prev = e;
+		cache->head = e;
+	}
+	return 1;
+}
+
+
+/*
+** Start caching the rows of the Cursor object on top of the stack,
+** opened for the prepared query missed by result_lookup under the key
+** at index key. The result is kept once the cursor reaches its end, for ttl
+** seconds (the default of the cache if negative).
+*/
+static void result_capture (lua_State *L, conn_data *conn, int key, stmt_entry *entry, double ttl) {
+	result_cache *cache = &(conn->envp->cache);
+	cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+	ifx_sqlda_t *sqlda = entry->sqlda;
+	ifx_sqlvar_t *sqlvar, *col;
+	char tables[RESULT_TABLES_SIZE];
+	size_t key_len, tables_len, names_len = 0;
+	const char *k = lua_tolstring(L, key, &key_len);
+	result_entry *e;
+	char *s;
+	int i;
+
+	tables_len = sql_read_tables(entry->sql, entry->sql_len, tables, sizeof(tables));
+	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++)
+		names_len += strlen(sqlvar->sqlname) + 1;
+	e = (result_entry *)malloc(sizeof(result_entry) + sqlda->sqld * sizeof(ifx_sqlvar_t)
+		+ key_len + tables_len + names_len);
+	if (e == NULL) {
+		cache->bypasses++;
+		return;
+	}
+	memset(e, 0, sizeof(result_entry) + sqlda->sqld * sizeof(ifx_sqlvar_t));
+	e->sqlda.sqld = sqlda->sqld;
+	e->sqlda.sqlvar = (ifx_sqlvar_t *)(e + 1);
+	s = (char *)(e->sqlda.sqlvar + sqlda->sqld);
+	e->key = s;
+	e->key_len = key_len;
+	e->hash = sql_hash(k, key_len);
+	memcpy(s, k, key_len);
+	s += key_len;
+	e->tables = s;
+	memcpy(s, tables, tables_len);
+	s += tables_len;
+	for (i = 0, sqlvar = sqlda->sqlvar, col = e->sqlda.sqlvar; i < sqlda->sqld; i++, sqlvar++, col++) {
+		col->sqltype = sqlvar->sqltype;
+		col->sqllen = sqlvar->sqllen;
+		col->sqlxid = sqlvar->sqlxid;
+		col->sqlname = s;
+		strcpy(s, sqlvar->sqlname);
+		s += strlen(s) + 1;
+	}
+	e->head_size = e->size = s - (char *)e;
+	e->ttl = (ttl >= 0) ? ttl : cache->ttl;
+	e->cache = cache;
+	e->refs = 1;
+	e->next = cache->capturing;
+	if (cache->capturing != NULL)
+		cache->capturing->prev = e;
+	cache->capturing = e;
+	cur->capture = e;
+}
+
+
+/*
+** Execute an SQL statement.
+** conn:execute(sql [, timeout | {timeout=, scroll=, cache=}])
+** Return a Cursor object if the statement is a query, otherwise
+** return the number of tuples affected by the statement. A query gets
+** a SCROLL cursor if scroll is true, and is not looked up in the result
+** cache if cache is false; a number of seconds sets how long its result
+** is cached.
+*/
+static int conn_execute (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	size_t st_len;
+	const char *statement = luaL_checklstring(L, 2, &st_len);
+	double timeout = conn->timeout;
+	double start;
+	int scroll = 0;
+	int use_cache = 1, cached = -1, key = 0;
+	double ttl = -1;
+	stmt_entry *entry = NULL;
+	int ret;
+
+	if (lua_istable(L, 3)) {
+		lua_getfield(L, 3, "timeout");
+		timeout = luaL_optnumber(L, -1, timeout);
+		lua_getfield(L, 3, "scroll");
+		scroll = lua_toboolean(L, -1);
+		lua_getfield(L, 3, "cache");
+		if (lua_isboolean(L, -1))
+			use_cache = lua_toboolean(L, -1);
+		else
+			ttl = luaL_optnumber(L, -1, -1);
+		lua_pop(L, 3);
+	}
+	else
+		timeout = luaL_optnumber(L, 3, timeout);
+
+	set_conn(L, conn);
+	start = now_seconds();
+	conn->deadline = (timeout > 0) ? start + timeout : 0;
+	conn->stmt_cnt++;
+	if (use_cache && !scroll) {
+		cached = result_lookup(L, 1, conn, statement, st_len, 1, 0);
+		if (cached == 1) {
+			cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+			cur->started = start;
+			lua_pushvalue(L, 2);
+			cur->sql = luaL_ref(L, LUA_REGISTRYINDEX);
+			return 1;
+		}
+		if (cached == 0)
+			key = lua_gettop(L);
+	}
+	entry = stmt_prepare(L, conn, statement, st_len, 1);
+	if (entry == NULL) {
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), "prepare sql");
+		query_event(L, conn, statement, st_len, now_seconds() - start, 0, conn->conn_sqlca.sqlcode);
+		return 2;
+	}
+
+	if (entry->sqlda == NULL) {
+		/* not query, execute the sql statment */
+		ret = exec_stmt(L, conn, entry, (ifx_sqlda_t *)0);
+		query_event(L, conn, statement, st_len, now_seconds() - start,
+			(conn->conn_sqlca.sqlcode == 0) ? conn->conn_sqlca.sqlerrd[2] : 0, conn->conn_sqlca.sqlcode);
+	}
+	else { /* return tuples */
+		ret = open_cursor(L, 1, conn, entry, (ifx_sqlda_t *)0, scroll);
+		if (ret == 1) {
+			/* reported when the cursor is done with */
+			cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+			cur->started = start;
+			lua_pushvalue(L, 2);
+			cur->sql = luaL_ref(L, LUA_REGISTRYINDEX);
+			if (cached == 0)
+				result_capture(L, conn, key, entry, ttl);
+		}
+		else
+			query_event(L, conn, statement, st_len, now_seconds() - start, 0, conn->conn_sqlca.sqlcode);
+	}
+	stmt_release(L, entry);
+	return ret;
+}
+
+
+/*
+** Asynchronous conn:execute. A worker thread makes the connection
+** current, prepares the statement and executes it or opens its cursor,
+** then makes the connection dormant again and writes a byte to a pipe.
+** The owning Lua state collects the result: the affected rows, or a
+** Cursor object it fetches from as usual. The worker times its steps
+** into the stats of the call, added to those of the connection when it
+** is joined. Needs the thread-safe build (IFX_THREAD).
+*/
+typedef struct async_data {
+	short	closed;				/* result collected */
+	int		conn;				/* reference to connection */
+	conn_data *connp;
+	int		fd[2];				/* pipe, readable when the work is done */
+	int		joined;
+#ifdef IFX_THREAD
+	pthread_t thread;
+#endif
+	char	*sql;
+	size_t	sql_len;
+	stmt_entry *entry;			/* statement, NULL if the prepare failed */
+	const char *hint;			/* failing step, NULL on success */
+	char	curid[64];
+	double	started, elapsed;	/* of the work, for the query hook */
+	conn_stats stats;			/* timed by the worker */
+} async_data;
+
+
+static async_data *getasync (lua_State *L) {
+	async_data *a = (async_data *)luaL_checkudata(L, 1, LUASQL_ASYNC_INFORMIX);
+	luaL_argcheck(L, a != NULL, 1, "async handle expected");
+	return a;
+}
+
+
+#ifdef IFX_THREAD
+/*
+** Work of an asynchronous call, no Lua calls here.
+*/
+static void *async_run (void *arg) {
+	async_data *a = (async_data *)arg;
+	conn_data *conn = a->connp;
+	stmt_entry *entry;
+
+	active_conn = conn;			/* for break_callback */
+	sqli_connect_set(0, conn->conn_name, 0);
+	memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode != 0) {
+		a->hint = "set connection";
+	}
+	else {
+		entry = a->entry = stmt_prepare(NULL, conn, a->sql, a->sql_len, 0);
+		if (entry == NULL) {
+			a->hint = "prepare sql";
+		}
+		else if (entry->sqlda == NULL) {
+			double start = now_seconds();
+			sqli_exec(ESQLINTVERSION, entry->stmt, (ifx_sqlda_t *)0, (char *)0, (struct value *)0,
+				(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0);
+			memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
+			stat_time(conn->timing, STAT_EXECUTE, start);
+			if (sqlca.sqlcode != 0)
+				a->hint = "execute sql";
+		}
+		else {
+			a->hint = curs_open(conn, entry, (ifx_sqlda_t *)0, a->curid, 0);
+		}
+		sqli_connect_set(0, conn->conn_name, 1);
+	}
+	active_conn = NULL;
+	a->elapsed = now_seconds() - a->started;
+	while ((write(a->fd[1], "", 1) < 0) && (errno == EINTR))
+		;
+	return NULL;
+}
+#endif
+
+
+/*
+** Check whether the work is done, waiting up to ms milliseconds
+** (forever if negative). Joins the worker once it is.
+*/
+static int async_ready (async_data *a, int ms) {
+	struct pollfd pfd;
+
+	if (a->joined)
+		return 1;
+	pfd.fd = a->fd[0];
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	while (poll(&pfd, 1, ms) < 0) {
+		if (errno != EINTR)
+			return 0;
+	}
+	if (!(pfd.revents & (POLLIN | POLLHUP)))
+		return 0;
+#ifdef IFX_THREAD
+	pthread_join(a->thread, NULL);
+#endif
+	a->joined = 1;
+	a->connp->async = NULL;
+	a->connp->timing = &(a->connp->stats);
+	stats_add(&(a->connp->stats), &(a->stats));
+	return 1;
+}
+
+
+/*
+** Free what an uncollected result holds.
+*/
+static void async_drop (lua_State *L, async_data *a) {
+	conn_data *conn = a->connp;
+
+	if (a->entry != NULL) {
+		if (!(conn->closed)) {
+			set_conn(L, conn);
+			if ((a->hint == NULL) && (a->entry->sqlda != NULL)) {
+				sqli_curs_close(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, a->curid, 768));
+				sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, a->curid, 770));
+			}
+		}
+		stmt_free(L, a->entry);
+		a->entry = NULL;
+	}
+}
+
+
+/*
+** Start an asynchronous execution of an SQL statement, within timeout
+** seconds if given. Return an async handle.
+*/
+static int conn_execute_async (lua_State *L) {
+#ifdef IFX_THREAD
+	conn_data *conn = getconnection(L);
+	size_t st_len;
+	const char *statement = luaL_checklstring(L, 2, &st_len);
+	double timeout = luaL_optnumber(L, 3, conn->timeout);
+	async_data *a;
+
+	if (conn->async != NULL)
+		luaL_error(L, LUASQL_PREFIX"connection is busy with an asynchronous call");
+	a = (async_data *)lua_newuserdata(L, sizeof(async_data) + st_len + 1);
+	memset(a, 0, sizeof(async_data));
+	a->fd[0] = a->fd[1] = -1;
+	a->joined = 1;
+	a->conn = LUA_NOREF;
+	luasql_setmeta(L, LUASQL_ASYNC_INFORMIX);
+	if (pipe(a->fd) != 0) {
+		lua_pushnil(L);
+		lua_pushfstring(L, LUASQL_PREFIX"create pipe fail: %s", strerror(errno));
+		return 2;
+	}
+	a->sql = (char *)(a + 1);
+	memcpy(a->sql, statement, st_len + 1);
+	a->sql_len = st_len;
+	a->connp = conn;
+	lua_pushvalue(L, 1);
+	a->conn = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	/* the worker makes the connection current in its thread */
+	if (make_dormant(conn) != 0) {
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), "set connection dormant");
+		return 2;
+	}
+	conn->stmt_cnt++;
+	snprintf(a->curid, sizeof(a->curid), "c_%lX_%d", (unsigned long)(uintptr_t)conn, conn->stmt_cnt);
+	conn->cancel = 0;
+	conn->broken = NULL;
+	conn->deadline = (timeout > 0) ? now_seconds() + timeout : 0;
+	a->started = now_seconds();
+	conn->timing = &(a->stats);
+	conn->async = a;
+	a->joined = 0;
+	if (pthread_create(&(a->thread), NULL, async_run, a) != 0) {
+		conn->async = NULL;
+		conn->timing = &(conn->stats);
+		a->joined = 1;
+		lua_pushnil(L);
+		lua_pushstring(L, LUASQL_PREFIX"create worker thread fail");
+		return 2;
+	}
+	return 1;
+#else
+	getconnection(L);
+	return luasql_faildirect(L, "asynchronous calls need the thread-safe build (IFX_THREAD)");
+#endif
+}
+
+
+/*
+** Return true if the call is done, without waiting.
+*/
+static int async_poll (lua_State *L) {
+	lua_pushboolean(L, async_ready(getasync(L), 0));
+	return 1;
+}
+
+
+/*
+** Wait up to timeout seconds (forever without one) for the call.
+** Return true if it is done.
+*/
+static int async_wait (lua_State *L) {
+	async_data *a = getasync(L);
+	int ms = lua_isnoneornil(L, 2) ? -1 : (int)(luaL_checknumber(L, 2) * 1000);
+	lua_pushboolean(L, async_ready(a, ms));
+	return 1;
+}
+
+
+/*
+** Descriptor that becomes readable when the call is done, for event loops.
+*/
+static int async_fd (lua_State *L) {
+	lua_pushinteger(L, getasync(L)->fd[0]);
+	return 1;
+}
+
+
+/*
+** Wait for the call and return what conn:execute would have.
+*/
+static int async_result (lua_State *L) {
+	async_data *a = getasync(L);
+	conn_data *conn = a->connp;
+	stmt_entry *entry = a->entry;
+	const char *broken;
+	int ret;
+
+	luaL_argcheck(L, !a->closed, 1, "result already collected");
+	async_ready(a, -1);
+	a->closed = 1;
+	luaL_argcheck(L, !(conn->closed), 1, "connection is closed");
+	broken = conn->broken;
+	set_conn(L, conn);
+	conn->broken = broken;
+	if ((entry != NULL) && (entry->sqlda == NULL))
+		result_written(L, conn, a->sql, a->sql_len);
+	if (a->hint != NULL) {
+		async_drop(L, a);
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), (char *)a->hint);
+		query_event(L, conn, a->sql, a->sql_len, a->elapsed, 0, conn->conn_sqlca.sqlcode);
+		return 2;
+	}
+	a->entry = NULL;
+	if (entry->sqlda == NULL) {
+		/* return affected rows */
+		lua_pushinteger(L, conn->conn_sqlca.sqlerrd[2]);
+		pusherrmsg(L, &(conn->conn_sqlca), "execute sql");
+		query_event(L, conn, a->sql, a->sql_len, a->elapsed,
+			(conn->conn_sqlca.sqlcode == 0) ? conn->conn_sqlca.sqlerrd[2] : 0, conn->conn_sqlca.sqlcode);
+		ret = 2;
+	}
+	else {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, a->conn);
+		ret = wrap_cursor(L, lua_gettop(L), conn, entry, a->curid);
+		if (ret == 1) {
+			/* reported when the cursor is done with */
+			cur_data *cur = (cur_data *)lua_touserdata(L, -1);
+			cur->started = a->started;
+			lua_pushlstring(L, a->sql, a->sql_len);
+			cur->sql = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+		else
+			query_event(L, conn, a->sql, a->sql_len, a->elapsed, 0, conn->conn_sqlca.sqlcode);
+	}
+	stmt_release(L, entry);
+	return ret;
+}
+
+
+#if LUA_VERSION_NUM >= 503
+static int async_await_k (lua_State *L, int status, lua_KContext ctx) {
+	async_data *a = getasync(L);
+
+	lua_settop(L, 1);
+	if (!async_ready(a, 0)) {
+		lua_pushinteger(L, a->fd[0]);
+		return lua_yieldk(L, 1, 0, async_await_k);
+	}
+	return async_result(L);
+}
+#endif
+
+
+/*
+** Return the result of the call. Inside a coroutine, yield the
+** descriptor of the handle until the call is done; the scheduler resumes
+** the coroutine once it is readable. Elsewhere (and before Lua 5.3),
+** block like result.
+*/
+static int async_await (lua_State *L) {
+#if LUA_VERSION_NUM >= 503
+	if (lua_isyieldable(L))
+		return async_await_k(L, LUA_OK, 0);
+#endif
+	return async_result(L);
+}
+
+
+static int async_gc (lua_State *L) {
+	async_data *a = (async_data *)luaL_checkudata(L, 1, LUASQL_ASYNC_INFORMIX);
+
+	if (a == NULL)
+		return 0;
+	async_ready(a, -1);
+	if (!(a->closed)) {
+		a->closed = 1;
+		if (a->connp != NULL)
+			async_drop(L, a);
+	}
+	if (a->fd[0] >= 0) {
+		close(a->fd[0]);
+		close(a->fd[1]);
+		a->fd[0] = a->fd[1] = -1;
+	}
+	luaL_unref(L, LUA_REGISTRYINDEX, a->conn);
+	a->conn = LUA_NOREF;
+	return 0;
+}
+
+
+/*
+** Drop all cached prepared statements, e.g. after DDL.
+*/
+static int conn_flushcache (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	set_conn(L, conn);
+	stmt_cache_flush(L, &(conn->cache));
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Set the max number of cached prepared statements, 0 disables the cache.
+*/
+static int conn_setcachesize (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	int size = (int)luaL_checkinteger(L, 2);
+
+	luaL_argcheck(L, size >= 0, 2, "cache size must be non-negative");
+	set_conn(L, conn);
+	if (stmt_cache_resize(L, &(conn->cache), size) != 0) {
+		return luasql_faildirect(L, "alloc memory fail");
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Get statement cache counters, and the connection switches and
+** cursor lookups made or avoided
+*/
+static int conn_getcachestats (lua_State *L) {
+	conn_data *conn = getconnection(L);
+
+	lua_newtable(L);
+	lua_pushstring(L, "size");
+	lua_pushinteger(L, conn->cache.size);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "count");
+	lua_pushinteger(L, conn->cache.count);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "hits");
+	lua_pushinteger(L, conn->cache.hits);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "misses");
+	lua_pushinteger(L, conn->cache.misses);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "evictions");
+	lua_pushinteger(L, conn->cache.evictions);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "switches");
+	lua_pushinteger(L, conn->switches);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "switches_skipped");
+	lua_pushinteger(L, conn->switches_skipped);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "lookups_skipped");
+	lua_pushinteger(L, conn->lookups_skipped);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "timeouts");
+	lua_pushinteger(L, conn->stats.timeouts);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "cancels");
+	lua_pushinteger(L, conn->stats.cancels);
+	lua_rawset(L, -3);
+	return 1;
+}
+
+
+/*
+** Push the counters as a table:
+** {prepare = {count=, time=, max=, hist={...}}, describe=, open=, fetch=,
+**  execute=, commit=, rollback=, rows=, bytes_decoded=, buffer_bytes=,
+**  result_hits=, result_misses=, timeouts=, cancels=}
+*/
+static void pushstats (lua_State *L, const conn_stats *stats) {
+	static const char *const names[NSTATS] = {
+		"prepare", "describe", "open", "fetch", "execute", "commit", "rollback"
+	};
+	const op_stats *p;
+	int i, b;
+
+	lua_newtable(L);
+	for (i = 0; i < NSTATS; i++) {
+		p = &(stats->ops[i]);
+		lua_pushstring(L, names[i]);
+		lua_createtable(L, 0, 4);
+		lua_pushstring(L, "count");
+		lua_pushinteger(L, p->count);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "time");
+		lua_pushnumber(L, p->time);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "max");
+		lua_pushnumber(L, p->max);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "hist");
+		lua_createtable(L, HIST_BUCKETS, 0);
+		for (b = 0; b < HIST_BUCKETS; b++) {
+			lua_pushinteger(L, p->hist[b]);
+			lua_rawseti(L, -2, b+1);
+		}
+		lua_rawset(L, -3);
+		lua_rawset(L, -3);
+	}
+	lua_pushstring(L, "rows");
+	lua_pushinteger(L, stats->rows);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "bytes_decoded");
+	lua_pushnumber(L, stats->bytes_decoded);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "buffer_bytes");
+	lua_pushnumber(L, stats->buffer_bytes);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "result_hits");
+	lua_pushinteger(L, stats->result_hits);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "result_misses");
+	lua_pushinteger(L, stats->result_misses);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "timeouts");
+	lua_pushinteger(L, stats->timeouts);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "cancels");
+	lua_pushinteger(L, stats->cancels);
+	lua_rawset(L, -3);
+}
+
+
+/*
+** Counters and latency histograms of the connection, cleared
+** afterwards if reset is true.
+** conn:stats([reset])
+*/
+static int conn_stats_fn (lua_State *L) {
+	conn_data *conn = getconnection(L);
+
+	pushstats(L, &(conn->stats));
+	if (lua_toboolean(L, 2))
+		memset(&(conn->stats), 0, sizeof(conn_stats));
+	return 1;
+}
+
+
+/*
+** Set the function called after each statement, nil to remove it.
+** opts.slow sets the seconds from which statements go to the slow log,
+** negative to log none.
+** conn:sethook(fn [, {slow=}])
+*/
+static int conn_sethook (lua_State *L) {
+	conn_data *conn = getconnection(L);
+
+	if (!lua_isnil(L, 2))
+		luaL_checktype(L, 2, LUA_TFUNCTION);
+	if (lua_istable(L, 3)) {
+		lua_getfield(L, 3, "slow");
+		conn->slow = luaL_optnumber(L, -1, conn->slow);
+		lua_pop(L, 1);
+	}
+	luaL_unref(L, LUA_REGISTRYINDEX, conn->hook);
+	conn->hook = LUA_NOREF;
+	if (!lua_isnil(L, 2)) {
+		lua_pushvalue(L, 2);
+		conn->hook = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Start writing the cursors opened afterwards, and the rows fetched
+** from them, to a trace file for conn:replay. Stop tracing without a
+** path.
+** conn:settrace([path])
+*/
+static int conn_settrace (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	const char *path = luaL_optstring(L, 2, NULL);
+	int4 head[2];
+
+	if (trace_close(conn))
+		return luasql_faildirect(L, "write trace file fail");
+	if (path != NULL) {
+		conn->trace = fopen(path, "wb");
+		if (conn->trace == NULL)
+			return luasql_faildirect(L, "open trace file fail");
+		head[0] = TRACE_VERSION;
+		head[1] = TRACE_ORDER;
+		conn->trace_start = now_seconds();
+		trace_put(conn, TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1);
+		trace_put(conn, head, sizeof(head));
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+static int4 trace_get4 (const char *p) {
+	int4 v;
+	memcpy(&v, p, sizeof(int4));
+	return v;
+}
+
+static int2 trace_get2 (const char *p) {
+	int2 v;
+	memcpy(&v, p, sizeof(int2));
+	return v;
+}
+
+
+static replay_data *getreplay (lua_State *L) {
+	replay_data *rep = (replay_data *)luaL_checkudata(L, 1, LUASQL_REPLAY_INFORMIX);
+	luaL_argcheck(L, rep != NULL, 1, "replay expected");
+	luaL_argcheck(L, !rep->closed, 1, "replay is closed");
+	return rep;
+}
+
+
+/*
+** Find the recorded cursor of an id, NULL if it was not described.
+*/
+static trace_cursor *replay_find (replay_data *rep, unsigned int id) {
+	int lo = 0, hi = rep->ncursors - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (rep->cursors[mid].id == id)
+			return rep->cursors + mid;
+		if (rep->cursors[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+
+/*
+** Fill tc from the describe record of len bytes at p.
+** Return an error message, or NULL.
+*/
+static const char *replay_describe (trace_cursor *tc, const char *p, size_t len) {
+	const char *end = p + len;
+	int4 off;
+	int2 n;
+	int i;
+
+	if (len < sizeof(int4))
+		return "bad trace record";
+	tc->sql_len = (size_t)trace_get4(p);
+	p += sizeof(int4);
+	if ((tc->sql_len > (size_t)(end - p)) || ((size_t)(end - p) - tc->sql_len < sizeof(int2) + sizeof(int4)))
+		return "bad trace record";
+	tc->sql = p;
+	p += tc->sql_len;
+	tc->sqld = trace_get2(p);
+	tc->buflen = (size_t)trace_get4(p + sizeof(int2));
+	p += sizeof(int2) + sizeof(int4);
+	if (tc->sqld <= 0)
+		return "bad trace record";
+	tc->cols = p;
+	for (i = 0; i < tc->sqld; i++) {
+		if ((size_t)(end - p) < TRACE_COL)
+			return "bad trace record";
+		off = trace_get4(p + TRACE_COL - sizeof(int2) - sizeof(int4));
+		n = trace_get2(p + TRACE_COL - sizeof(int2));
+		if ((off < 0) || ((size_t)off >= tc->buflen) || (n < 0) || ((size_t)(end - p) - TRACE_COL < (size_t)n))
+			return "bad trace record";
+		if (trace_get2(p) == CLOCATORTYPE)
+			tc->has_loc = 1;
+		p += TRACE_COL + n;
+	}
+	return NULL;
+}
+
+
+/*
+** Check the row record of tc of len bytes at p.
+*/
+static int replay_checkrow (trace_cursor *tc, const char *p, size_t len) {
+	const char *end = p + len, *c = tc->cols;
+	size_t need = tc->sqld * sizeof(int2) + tc->buflen;
+	int4 n;
+	int i;
+
+	if (len < need)
+		return 0;
+	p += need;
+	for (i = 0; tc->has_loc && (i < tc->sqld); i++) {
+		if (trace_get2(c) == CLOCATORTYPE) {
+			if ((size_t)(end - p) < sizeof(int4))
+				return 0;
+			n = trace_get4(p);
+			p += sizeof(int4);
+			if (n > 0) {
+				if ((size_t)(end - p) < (size_t)n)
+					return 0;
+				p += n;
+			}
+		}
+		c += TRACE_COL + trace_get2(c + TRACE_COL - sizeof(int2));
+	}
+	return 1;
+}
+
+
+/*
+** Read a trace file and index the rows of each recorded cursor: the
+** first pass counts the cursors, the second describes them and counts
+** their rows, the third collects the rows. Rows and ends of cursors
+** not described, opened before the trace started, are skipped.
+** Return an error message, or NULL.
+*/
+static const char *replay_load (replay_data *rep, const char *path) {
+	FILE *fp = fopen(path, "rb");
+	const char *p, *end, *err;
+	trace_cursor *tc;
+	long size, nrows = 0;
+	size_t len;
+	int pass, i;
+
+	if (fp == NULL)
+		return "open trace file fail";
+	if ((fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 0) || (fseek(fp, 0, SEEK_SET) != 0)) {
+		fclose(fp);
+		return "read trace file fail";
+	}
+	rep->data = (char *)malloc(size + 1);
+	if (rep->data == NULL) {
+		fclose(fp);
+		return "alloc memory fail";
+	}
+	if (fread(rep->data, 1, size, fp) != (size_t)size) {
+		fclose(fp);
+		return "read trace file fail";
+	}
+	fclose(fp);
+	rep->size = size;
+	if (((size_t)size < TRACE_HEAD) || (memcmp(rep->data, TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1) != 0)
+	  || (trace_get4(rep->data + sizeof(TRACE_MAGIC) - 1) != TRACE_VERSION))
+		return "not a trace file";
+	if (trace_get4(rep->data + sizeof(TRACE_MAGIC) - 1 + sizeof(int4)) != TRACE_ORDER)
+		return "trace file of another platform";
+
+	end = rep->data + size;
+	for (pass = 0; pass < 3; pass++) {
+		for (p = rep->data + TRACE_HEAD; p < end; p += TRACE_REC + len) {
+			unsigned int id;
+			bigint usec;
+
+			if ((size_t)(end - p) < TRACE_REC)
+				return "truncated trace file";
+			id = (unsigned int)trace_get4(p + 1);
+			memcpy(&usec, p + 1 + sizeof(int4), sizeof(bigint));
+			len = (size_t)(unsigned int)trace_get4(p + 1 + sizeof(int4) + sizeof(bigint));
+			if (len > (size_t)(end - p) - TRACE_REC)
+				return "truncated trace file";
+			if (pass == 0) {
+				if (*p == TRACE_DESCRIBE)
+					rep->ncursors++;
+				continue;
+			}
+			if (*p == TRACE_DESCRIBE) {
+				if (pass == 2)
+					continue;
+				if ((rep->ncursors > 0) && (rep->cursors[rep->ncursors - 1].id >= id))
+					return "bad trace record";
+				tc = rep->cursors + rep->ncursors++;
+				tc->rep = rep;
+				tc->id = id;
+				tc->ts = usec / 1e6;
+				tc->endcode = 100;
+				err = replay_describe(tc, p + TRACE_REC, len);
+				if (err != NULL)
+					return err;
+				continue;
+			}
+			tc = replay_find(rep, id);
+			if (tc == NULL)
+				continue;
+			if (*p == TRACE_ROW) {
+				if (pass == 2)
+					tc->rows[tc->nrows++] = p;
+				else if (replay_checkrow(tc, p + TRACE_REC, len)) {
+					tc->nrows++;
+					nrows++;
+				}
+				else
+					return "bad trace record";
+			}
+			else if ((*p == TRACE_END) && (pass == 1) && (len >= sizeof(int4)))
+				tc->endcode = trace_get4(p + TRACE_REC);
+		}
+		if (pass == 0) {
+			rep->cursors = (trace_cursor *)calloc(rep->ncursors + 1, sizeof(trace_cursor));
+			if (rep->cursors == NULL)
+				return "alloc memory fail";
+			rep->ncursors = 0;
+		}
+		else if (pass == 1) {
+			rep->rows = (const char **)malloc((nrows + 1) * sizeof(const char *));
+			if (rep->rows == NULL)
+				return "alloc memory fail";
+			for (i = 0, nrows = 0; i < rep->ncursors; i++) {
+				rep->cursors[i].rows = rep->rows + nrows;
+				nrows += rep->cursors[i].nrows;
+				rep->cursors[i].nrows = 0;
+			}
+		}
+	}
+	return NULL;
+}
+
+
+/*
+** Load a trace file of conn:settrace to replay its cursors on this
+** connection, at full speed or at the times they were traced.
+** conn:replay(path [, "full"|"recorded"])
+*/
+static int conn_replay (lua_State *L) {
+	static const char *const modes[] = {"full", "recorded", NULL};
+	const char *path, *err;
+	replay_data *rep;
+	int timed;
+
+	getconnection(L);
+	path = luaL_checkstring(L, 2);
+	timed = luaL_checkoption(L, 3, "full", modes);
+	rep = (replay_data *)lua_newuserdata(L, sizeof(replay_data));
+	memset(rep, 0, sizeof(replay_data));
+	rep->conn = LUA_NOREF;
+	luasql_setmeta(L, LUASQL_REPLAY_INFORMIX);
+	err = replay_load(rep, path);
+	if (err != NULL)
+		return luasql_faildirect(L, err);
+	rep->timed = timed;
+	lua_pushvalue(L, 1);
+	rep->conn = luaL_ref(L, LUA_REGISTRYINDEX);
+	rep->start = now_seconds();
+	return 1;
+}
+
+
+/*
+** Open the next recorded cursor. Its rows are fetched from the trace
+** through the usual fetch methods, decoded with the fetch options of
+** the connection.
+** Return the Cursor object and its SQL text, or nil after the last one.
+*/
+static int replay_next (lua_State *L) {
+	replay_data *rep = getreplay(L);
+	conn_data *conn = getconnfromref(L, rep->conn);
+	trace_cursor *tc;
+	cur_data *cur;
+	arena_layout layout;
+	ifx_sqlda_t *sqlda;
+	ifx_sqlvar_t *sqlvar;
+	const char *c;
+	char *arena, *names;
+	int i;
+
+	luaL_argcheck(L, !conn->closed, 1, "connection is closed");
+	if (rep->next >= rep->ncursors) {
+		lua_pushnil(L);
+		return 1;
+	}
+	tc = rep->cursors + rep->next;
+
+	/* the arena of the traced cursor, with the recorded buffer layout */
+	layout.size = sizeof(ifx_sqlda_t) + tc->sqld * sizeof(ifx_sqlvar_t);
+	for (i = 0, c = tc->cols; i < tc->sqld; i++) {
+		int2 n = trace_get2(c + TRACE_COL - sizeof(int2));
+		layout.size += n + 1;
+		c += TRACE_COL + n;
+	}
+	layout.dec_off = ARENA_ALIGN(layout.size);
+	layout.ind_off = ARENA_ALIGN(layout.dec_off + tc->sqld * sizeof(col_decoder));
+	layout.buf_off = ARENA_ALIGN(layout.ind_off + tc->sqld * sizeof(int2));
+	layout.size = layout.buf_off + tc->buflen;
+	arena = arena_get(conn, layout.size);
+	if (arena == NULL)
+		return luasql_faildirect(L, "alloc fetch buffer fail");
+	rep->next++;
+	if (rep->timed)
+		replay_wait(rep, tc->ts);
+
+	memset(arena, 0, layout.size);
+	sqlda = (ifx_sqlda_t *)arena;
+	sqlda->sqld = tc->sqld;
+	sqlda->sqlvar = (ifx_sqlvar_t *)(sqlda + 1);
+	names = (char *)(sqlda->sqlvar + tc->sqld);
+	for (i = 0, c = tc->cols, sqlvar = sqlda->sqlvar; i < tc->sqld; i++, sqlvar++) {
+		int2 n = trace_get2(c + TRACE_COL - sizeof(int2));
+		sqlvar->sqltype = trace_get2(c);
+		sqlvar->sqllen = trace_get4(c + sizeof(int2));
+		sqlvar->sqlxid = trace_get4(c + sizeof(int2) + sizeof(int4));
+		sqlvar->sqldata = arena + layout.buf_off + trace_get4(c + sizeof(int2) + 2 * sizeof(int4));
+		sqlvar->sqlind = (int2 *)(arena + layout.ind_off) + i;
+		sqlvar->sqlname = names;
+		memcpy(names, c + TRACE_COL, n);
+		names[n] = '\0';
+		names += n + 1;
+		c += TRACE_COL + n;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, rep->conn);
+	create_cursor(L, lua_gettop(L), NULL, arena, &layout);
+	cur = (cur_data *)lua_touserdata(L, -1);
+	cur->replay = tc;
+	lua_pushvalue(L, 1);
+	cur->replay_obj = luaL_ref(L, LUA_REGISTRYINDEX);
+	rep->open++;
+	lua_pushlstring(L, tc->sql, tc->sql_len);
+	return 2;
+}
+
+
+static int replay_gc (lua_State *L) {
+	replay_data *rep = (replay_data *)luaL_checkudata(L, 1, LUASQL_REPLAY_INFORMIX);
+
+	if ((rep == NULL) || rep->closed)
+		return 0;
+	rep->closed = 1;
+	free(rep->rows);
+	free(rep->cursors);
+	free(rep->data);
+	rep->rows = NULL;
+	rep->cursors = NULL;
+	rep->data = NULL;
+	luaL_unref(L, LUA_REGISTRYINDEX, rep->conn);
+	rep->conn = LUA_NOREF;
+	return 0;
+}
+
+
+/*
+** Close a replay object. Its cursors hold it, they must be closed
+** first.
+*/
+static int replay_close (lua_State *L) {
+	replay_data *rep = (replay_data *)luaL_checkudata(L, 1, LUASQL_REPLAY_INFORMIX);
+	luaL_argcheck(L, rep != NULL, 1, LUASQL_PREFIX"replay expected");
+	if (rep->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	if (rep->open > 0)
+		return luasql_faildirect(L, "there are open cursors");
+	replay_gc(L);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Change a fetch option of the cursors opened afterwards.
+*/
+static int conn_setoption (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	setoption(L, &(conn->opts), 2);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Locator callbacks of a large object parameter read from a Lua
+** function. A failing function stops the transfer, its error is kept
+** for readererror.
+*/
+static mint reader_open (ifx_loc_t *loc, mint flag, mint bsize) {
+	lob_reader *rd = (lob_reader *)loc->loc_user_env;
+	rd->chunk = LUA_NOREF;
+	rd->off = 0;
+	return 0;
+}
+
+static mint reader_read (ifx_loc_t *loc, char *buffer, mint buflen) {
+	lob_reader *rd = (lob_reader *)loc->loc_user_env;
+	lua_State *L = rd->L;
+	const char *s;
+	size_t len, n;
+
+	for (;;) {
+		if (rd->chunk != LUA_NOREF) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, rd->chunk);
+			s = lua_tolstring(L, -1, &len);
+			if (rd->off < len) {
+				n = len - rd->off;
+				if (n > (size_t)buflen)
+					n = buflen;
+				memcpy(buffer, s + rd->off, n);
+				rd->off += n;
+				lua_pop(L, 1);
+				return n;
+			}
+			lua_pop(L, 1);
+			luaL_unref(L, LUA_REGISTRYINDEX, rd->chunk);
+			rd->chunk = LUA_NOREF;
+		}
+		lua_pushvalue(L, rd->fn);
+		if (lua_pcall(L, 0, 1, 0) != 0) {
+			rd->err = luaL_ref(L, LUA_REGISTRYINDEX);
+			return -1;
+		}
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			return 0;
+		}
+		if (lua_type(L, -1) != LUA_TSTRING) {
+			lua_pop(L, 1);
+			lua_pushstring(L, "lob reader must return a string or nil");
+			rd->err = luaL_ref(L, LUA_REGISTRYINDEX);
+			return -1;
+		}
+		rd->chunk = luaL_ref(L, LUA_REGISTRYINDEX);
+		rd->off = 0;
+	}
+}
+
+static mint reader_close (ifx_loc_t *loc) {
+	lob_reader *rd = (lob_reader *)loc->loc_user_env;
+	luaL_unref(rd->L, LUA_REGISTRYINDEX, rd->chunk);
+	rd->chunk = LUA_NOREF;
+	return 0;
+}
+
+
+/*
+** Check whether an input parameter is a large object.
+*/
+inline static int is_lob_param (bind_param *param) {
+	int type = param->type & SQLTYPE;
+	return (type == SQLTEXT) || (type == SQLBYTES) ||
+		(ISUDTTYPE(type) && ((param->xid == XID_BLOB) || (param->xid == XID_CLOB)));
+}
+
+
+/*
+** Bind the value at index idx to a large object parameter through a
+** locator: a string is sent from memory, a table {file = path} from
+** the file and a function, or a table {reader = function, size = n},
+** from the strings the function returns until nil. File and reader
+** objects are sent in chunks by ESQL/C. The value at idx is replaced
+** by the path or the function to keep it alive.
+** Return an error message, or NULL on success.
+*/
+static const char *bind_lob (lua_State *L, int idx, ifx_sqlvar_t *sqlvar, bind_param *param) {
+	ifx_loc_t *loc = &(param->value.lob.loc);
+	lob_reader *rd = &(param->value.lob.rd);
+	int type = param->type & SQLTYPE;
+	int size = -1, file = 0;
+	size_t len;
+
+	memset(loc, 0, sizeof(ifx_loc_t));
+	loc->loc_type = ((type == SQLTEXT) || (param->xid == XID_CLOB)) ? SQLTEXT : SQLBYTES;
+	loc->loc_indicator = 0;
+	if (lua_istable(L, idx)) {
+		size = getoptint(L, idx, "size", -1);
+		lua_getfield(L, idx, "file");
+		file = lua_isstring(L, -1);
+		if (!file) {
+			lua_pop(L, 1);
+			lua_getfield(L, idx, "reader");
+			if (!lua_isfunction(L, -1))
+				return "lob table needs a file or a reader field";
+		}
+		lua_replace(L, idx);
+	}
+	switch (lua_type(L, idx)) {
+		case LUA_TSTRING:
+			if (file) {
+				loc->loc_loctype = LOCFNAME;
+				loc->loc_fname = (char *)lua_tostring(L, idx);
+				loc->loc_oflags = LOC_RONLY;
+				loc->loc_size = -1;
+			}
+			else {
+				loc->loc_loctype = LOCMEMORY;
+				loc->loc_buffer = (char *)lua_tolstring(L, idx, &len);
+				loc->loc_bufsize = len;
+				loc->loc_size = len;
+			}
+			break;
+		case LUA_TFUNCTION:
+			rd->L = L;
+			rd->fn = idx;
+			rd->chunk = LUA_NOREF;
+			rd->err = LUA_NOREF;
+			loc->loc_loctype = LOCUSER;
+			loc->loc_open = reader_open;
+			loc->loc_read = reader_read;
+			loc->loc_close = reader_close;
+			loc->loc_user_env = (char *)rd;
+			loc->loc_size = size;
+			break;
+		default:
+			return "lob parameter must be a string, a function or a table with file or reader";
+	}
+	sqlvar->sqltype = CLOCATORTYPE;
+	sqlvar->sqllen = sizeof(ifx_loc_t);
+	sqlvar->sqldata = (char *)loc;
+	return NULL;
+}
+
+
+/*
+** Bind the value at index idx to an input parameter, choosing the
+** C type from the described parameter type. Strings are bound in place,
+** so the value must stay on the stack until the statement is executed.
+** Strings for DECIMAL and MONEY are converted exactly, numbers go as
+** doubles.
+** Return an error message, or NULL on success.
+*/
+static const char *bind_value (lua_State *L, int idx, ifx_sqlvar_t *sqlvar, bind_param *param) {
+	int type = param->type & SQLTYPE;
+	size_t len;
+	const char *str;
+
+	*(sqlvar->sqlind) = 0;
+	if (is_lob_param(param) && !lua_isnil(L, idx))
+		return bind_lob(L, idx, sqlvar, param);
+	switch (lua_type(L, idx)) {
+		case LUA_TNIL:
+			*(sqlvar->sqlind) = -1;
+			sqlvar->sqltype = CSTRINGTYPE;
+			sqlvar->sqllen = 1;
+			sqlvar->sqldata = "";
+			return NULL;
+		case LUA_TBOOLEAN:
+			if (type == SQLBOOL) {
+				param->value.c = (char)lua_toboolean(L, idx);
+				sqlvar->sqltype = CBOOLTYPE;
+				sqlvar->sqllen = sizeof(char);
+			}
+			else {
+				param->value.i = lua_toboolean(L, idx);
+				sqlvar->sqltype = CINTTYPE;
+				sqlvar->sqllen = sizeof(int4);
+			}
+			sqlvar->sqldata = (char *)&(param->value);
+			return NULL;
+		case LUA_TNUMBER:
+			{
+				lua_Number n = lua_tonumber(L, idx);
+				sqlvar->sqldata = (char *)&(param->value);
+				switch (type) {
+					case SQLSMINT:
+					case SQLINT:
+					case SQLSERIAL:
+					case SQLDATE:
+						if ((n >= -2147483648.0) && (n <= 2147483647.0) && (n == (lua_Number)(int4)n)) {
+							param->value.i = (int4)n;
+							sqlvar->sqltype = (type == SQLDATE) ? CDATETYPE : CINTTYPE;
+							sqlvar->sqllen = sizeof(int4);
+							return NULL;
+						}
+						break;
+					case SQLINT8:
+					case SQLSERIAL8:
+					case SQLINFXBIGINT:
+					case SQLBIGSERIAL:
+#if LUA_VERSION_NUM >= 503
+						/* integers keep all 64 bits */
+						if (lua_isinteger(L, idx)) {
+							param->value.b = (bigint)lua_tointeger(L, idx);
+							sqlvar->sqltype = CBIGINTTYPE;
+							sqlvar->sqllen = sizeof(bigint);
+							return NULL;
+						}
+#endif
+						if ((n >= -9.2e18) && (n <= 9.2e18) && (n == (lua_Number)(bigint)n)) {
+							param->value.b = (bigint)n;
+							sqlvar->sqltype = CBIGINTTYPE;
+							sqlvar->sqllen = sizeof(bigint);
+							return NULL;
+						}
+						break;
+					case SQLSMFLOAT:
+					case SQLFLOAT:
+					case SQLDECIMAL:
+					case SQLMONEY:
+						param->value.d = n;
+						sqlvar->sqltype = CDOUBLETYPE;
+						sqlvar->sqllen = sizeof(double);
+						return NULL;
+				}
+				/* let the server convert the text of the number */
+				break;
+			}
+		case LUA_TSTRING:
+			/* DECIMAL and MONEY text keeps all its digits */
+			if ((type == SQLDECIMAL) || (type == SQLMONEY)) {
+				str = lua_tolstring(L, idx, &len);
+				if (deccvasc((char *)str, (mint)len, &(param->value.dec)) == 0) {
+					sqlvar->sqltype = CDECIMALTYPE;
+					sqlvar->sqllen = sizeof(dec_t);
+					sqlvar->sqldata = (char *)&(param->value);
+					return NULL;
+				}
+			}
+			break;
+		default:
+			return "unsupported parameter type";
+	}
+	str = lua_tolstring(L, idx, &len);
+	sqlvar->sqltype = CSTRINGTYPE;
+	sqlvar->sqllen = len + 1;
+	sqlvar->sqldata = (char *)str;
+	return NULL;
+}
+
+
+/*
+** Push the error of a failed lob reader of the statement and return 1,
+** or return 0 if none failed.
+*/
+static int readererror (lua_State *L, stmt_data *stmt) {
+	int nparams = (stmt->in_sqlda != NULL) ? stmt->in_sqlda->sqld : 0;
+	int i;
+
+	for (i = 0; i < nparams; i++) {
+		ifx_sqlvar_t *sqlvar = stmt->in_sqlda->sqlvar + i;
+		lob_reader *rd = &(stmt->params[i].value.lob.rd);
+		if ((sqlvar->sqltype == CLOCATORTYPE) &&
+			(stmt->params[i].value.lob.loc.loc_loctype == LOCUSER) &&
+			(rd->err != LUA_NOREF)) {
+			luaL_unref(L, LUA_REGISTRYINDEX, rd->chunk);
+			rd->chunk = LUA_NOREF;
+			lua_rawgeti(L, LUA_REGISTRYINDEX, rd->err);
+			luaL_unref(L, LUA_REGISTRYINDEX, rd->err);
+			rd->err = LUA_NOREF;
+			lua_pushfstring(L, "read lob fail, %s", lua_tostring(L, -1));
+			lua_remove(L, -2);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+** Check whether the statement has large object parameters.
+*/
+static int has_lob_params (stmt_data *stmt) {
+	int nparams = (stmt->in_sqlda != NULL) ? stmt->in_sqlda->sqld : 0;
+	int i;
+
+	for (i = 0; i < nparams; i++) {
+		if (is_lob_param(stmt->params + i))
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+** Bind the values from stack index first onwards to the input
+** parameters of the statement.
+** Return an error message, or NULL on success.
+*/
+static const char *bind_params (lua_State *L, stmt_data *stmt, int first) {
+	int nparams = (stmt->in_sqlda != NULL) ? stmt->in_sqlda->sqld : 0;
+	ifx_sqlvar_t *sqlvar = NULL;
+	const char *err;
+	int i;
+
+	if (lua_gettop(L) - first + 1 != nparams)
+		return "wrong number of parameters";
+	for (i = 0; i < nparams; i++) {
+		sqlvar = stmt->in_sqlda->sqlvar + i;
+		err = bind_value(L, first + i, sqlvar, stmt->params + i);
+		if (err != NULL)
+			return err;
 	}
-	/* Stores the references in the cursor structure */
-	cur->coltypes = luaL_ref (L, LUA_REGISTRYINDEX);
-	cur->colnames = luaL_ref (L, LUA_REGISTRYINDEX);
+	return NULL;
 }
 
 
 /*
-** Closes the cursos and nullify all structure fields.
+** Create a new Statement object and push it on top of the stack.
 */
-static void cur_nullify (lua_State *L, cur_data *cur) {
-	/* Nullify structure fields. */
-	conn_data *conn = getconnfromref(L, cur->conn);
+static int create_statement (lua_State *L, int conn, stmt_entry *entry, ifx_sqlda_t *in_sqlda) {
+	stmt_data *stmt = (stmt_data *)lua_newuserdata(L, sizeof(stmt_data));
+	int nparams = (in_sqlda != NULL) ? in_sqlda->sqld : 0;
 	ifx_sqlvar_t *sqlvar = NULL;
 	int i;
 
-	if (!(conn->closed)) {
-		set_conn(L, conn);
-		sqli_curs_close(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, cur->cur_name, 768));
+	luasql_setmeta(L, LUASQL_STATEMENT_INFORMIX);
+
+	/* fill in structure */
+	stmt->closed = 0;
+	stmt->conn = LUA_NOREF;
+	stmt->entry = entry;
+	stmt->in_sqlda = in_sqlda;
+	stmt->generation = ((conn_data *)lua_touserdata(L, conn))->generation;
+	stmt->params = (bind_param *)malloc(nparams * sizeof(bind_param) + nparams * sizeof(int2) + 1);
+	if (stmt->params == NULL) {
+		stmt->closed = 1;
+		return -1;
 	}
-	sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, cur->cur_name, 770));
-	cur->closed = 1;
-	free(cur->buf);
-	free(cur->indicators);
-	for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
-		if (sqlvar->sqltype == CLOCATORTYPE) {
-			ifx_loc_t *p = (ifx_loc_t *)sqlvar->sqldata;
-			if (p->loc_buffer != NULL)
-				free(p->loc_buffer);
-		}
+	stmt->in_ind = (int2 *)(stmt->params + nparams);
+	for (i = 0; i < nparams; i++) {
+		sqlvar = in_sqlda->sqlvar + i;
+		stmt->params[i].type = sqlvar->sqltype;
+		stmt->params[i].xid = sqlvar->sqlxid;
+		sqlvar->sqlind = stmt->in_ind + i;
 	}
-	free(cur->cur_sqlda);
-	luaL_unref(L, LUA_REGISTRYINDEX, cur->conn);
-	luaL_unref(L, LUA_REGISTRYINDEX, cur->colnames);
-	luaL_unref(L, LUA_REGISTRYINDEX, cur->coltypes);
+	lua_pushvalue (L, conn);
+	stmt->conn = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	return 0;
+}
+
+
+/*
+** Prepare an SQL statement with '?' parameter markers.
+** Return a Statement object.
+*/
+static int conn_prepare (lua_State *L) {
+	conn_data *conn = getconnection(L);
+	size_t st_len;
+	const char *statement = luaL_checklstring(L, 2, &st_len);
+	stmt_entry *entry = NULL;
+	ifx_sqlda_t *in_sqlda = NULL;
+
+	set_conn(L, conn);
+	conn->stmt_cnt++;
+	entry = stmt_prepare(L, conn, statement, st_len, 0);
+	if (entry == NULL) {
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), "prepare sql");
+		return 2;
+	}
+	entry->keep = 1;
+
+	sqli_describe_input_stmt(ESQLINTVERSION, entry->stmt, &in_sqlda, 0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode != 0) {
+		stmt_free(L, entry);
+		lua_pushnil(L);
+		pusherrmsg(L, &(conn->conn_sqlca), "describe input");
+		return 2;
+	}
+	if ((in_sqlda != NULL) && (in_sqlda->sqld == 0)) {
+		free(in_sqlda);
+		in_sqlda = NULL;
+	}
+
+	if (create_statement(L, 1, entry, in_sqlda) != 0) {
+		free(in_sqlda);
+		stmt_free(L, entry);
+		return luasql_faildirect(L, "alloc memory fail");
+	}
+	return 1;
+}
+
+
+/*
+** Free the prepared statement and nullify all structure fields.
+*/
+static void stmt_nullify (lua_State *L, stmt_data *stmt) {
+	conn_data *conn = getconnfromref(L, stmt->conn);
+
+	if (!(conn->closed))
+		set_conn(L, conn);
+	else
+		stmt->entry->stmt = NULL;	/* freed with its connection */
+	stmt->closed = 1;
+	stmt_free(L, stmt->entry);
+	free(stmt->in_sqlda);
+	free(stmt->params);
+	luaL_unref(L, LUA_REGISTRYINDEX, stmt->conn);
+}
+
+
+/*
+** Check the statement and the connection it belongs to, and make
+** the connection current.
+*/
+static conn_data *getstmtconn (lua_State *L, stmt_data *stmt) {
+	conn_data *conn = getconnfromref(L, stmt->conn);
+	luaL_argcheck(L, !conn->closed, 1, "connection is closed");
+	set_conn(L, conn);
+	return conn;
+}
+
+
+/*
+** Open a cursor of the prepared query with the parameter values bound
+** from index 2 to the top, over its cached result if there is one.
+*/
+static int stmt_open (lua_State *L, stmt_data *stmt, conn_data *conn) {
+	int last = lua_gettop(L);
+	int conn_idx, cached = -1, ret;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, stmt->conn);
+	conn_idx = lua_gettop(L);
+	if (!has_lob_params(stmt))
+		cached = result_lookup(L, conn_idx, conn, stmt->entry->sql, stmt->entry->sql_len, 2, last);
+	if (cached == 1)
+		return 1;
+	ret = open_cursor(L, conn_idx, conn, stmt->entry, stmt->in_sqlda, 0);
+	if ((cached == 0) && (ret == 1))
+		result_capture(L, conn, conn_idx + 1, stmt->entry, -1);
+	return ret;
+}
+
+
+/*
+** Execute the prepared statement with the given parameter values.
+** Return a Cursor object if the statement is a query, otherwise
+** return the number of tuples affected by the statement.
+*/
+static int stmt_execute (lua_State *L) {
+	stmt_data *stmt = getstatement(L);
+	conn_data *conn = getstmtconn(L, stmt);
+	const char *err = bind_params(L, stmt, 2);
+
+	if (err != NULL)
+		return luasql_faildirect(L, err);
+	conn->stmt_cnt++;
+	if (stmt->entry->sqlda == NULL) {
+		int ret = exec_stmt(L, conn, stmt->entry, stmt->in_sqlda);
+		if (lua_isnil(L, -2) && readererror(L, stmt))
+			lua_replace(L, -2);
+		return ret;
+	}
+	return stmt_open(L, stmt, conn);
+}
+
+
+/*
+** Open a cursor of the prepared query with the given parameter values.
+** Return a Cursor object.
+*/
+static int stmt_query (lua_State *L) {
+	stmt_data *stmt = getstatement(L);
+	conn_data *conn = getstmtconn(L, stmt);
+	const char *err = NULL;
+
+	if (stmt->entry->sqlda == NULL)
+		return luasql_faildirect(L, "statement is not a query");
+	err = bind_params(L, stmt, 2);
+	if (err != NULL)
+		return luasql_faildirect(L, err);
+	conn->stmt_cnt++;
+	return stmt_open(L, stmt, conn);
+}
+
+
+/*
+** Check whether the SQL text is an INSERT statement.
+*/
+static int is_insert (const char *sql) {
+	while (isspace((unsigned char)*sql))
+		sql++;
+	return (strncasecmp(sql, "insert", 6) == 0) && !isalnum((unsigned char)sql[6]);
+}
+
+
+/*
+** Push the values of the row at index i of the array at index rows,
+** and bind them to the input parameters of the statement.
+** Return an error message, or NULL on success.
+*/
+static const char *bind_row (lua_State *L, stmt_data *stmt, int rows, int i) {
+	int nparams = (stmt->in_sqlda != NULL) ? stmt->in_sqlda->sqld : 0;
+	int row, j;
+	const char *err;
+
+	lua_rawgeti(L, rows, i);
+	if (!lua_istable(L, -1))
+		return "row is not a table";
+	row = lua_gettop(L);
+	luaL_checkstack(L, nparams, LUASQL_PREFIX"too many parameters");
+	for (j = 0; j < nparams; j++) {
+		lua_rawgeti(L, row, j + 1);
+		err = bind_value(L, row + j + 1, stmt->in_sqlda->sqlvar + j, stmt->params + j);
+		if (err != NULL)
+			return err;
+	}
+	return NULL;
 }
 
 
 /*
-** Get another row of the given cursor.
+** Execute the prepared statement once for each row of an array of
+** parameter tables. INSERT statements go through an insert cursor,
+** so rows are sent to the server in buffered batches.
+** Options: batch (rows per flush), bufsize (insert buffer bytes).
+** Return the total affected rows and the array of per-batch counts, or
+** nil, the error message, the index of the first failing row and the
+** counts of the batches sent, the last one partial with the rows that
+** reached the table before the failure.
 */
-static int cur_fetch (lua_State *L) {
-	cur_data *cur = getcursor(L);
-	conn_data *conn = getconnfromref(L, cur->conn);
-	static _FetchSpec _FS0 = { 0, 1, 0 };
-	ifx_sqlvar_t *sqlvar = NULL;
+static int stmt_executemany (lua_State *L) {
+	stmt_data *stmt = getstatement(L);
+	conn_data *conn = getstmtconn(L, stmt);
+	int nrows, batch, bufsize, use_cursor, base, i;
+	int nbatch = 0, failed = 0;
+	long total = 0, batch_rows = 0;
+	char curid[64];
+	ifx_cursor_t *curs = NULL;
+	const char *err = NULL;
+	char *hint = NULL;
+
+	if (stmt->entry->sqlda != NULL)
+		return luasql_faildirect(L, "statement is a query");
+	luaL_checktype(L, 2, LUA_TTABLE);
+	result_written(L, conn, stmt->entry->sql, stmt->entry->sql_len);
+	nrows = (int)lua_rawlen(L, 2);
+	batch = getoptint(L, 3, "batch", nrows);
+	bufsize = getoptint(L, 3, "bufsize", 0);
+	if (batch <= 0)
+		batch = (nrows > 0) ? nrows : 1;
+	lua_settop(L, 3);
+	lua_newtable(L);				/* per-batch counts at index 4 */
+	base = lua_gettop(L);
 
-	set_conn(L, conn);
-	sqli_curs_fetch(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, cur->cur_name, 768),
-		(ifx_sqlda_t *)0, cur->cur_sqlda, (char *)0, &_FS0);
-	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
-	if (sqlca.sqlcode != 0) {
-		cur_nullify(L, cur);
-		lua_pushnil(L);
-		if (conn->conn_sqlca.sqlcode == 100) {
-			return 1;
+	conn->stmt_cnt++;
+	/* large objects are sent when a row is put, not buffered */
+	use_cursor = is_insert(stmt->entry->sql) && !has_lob_params(stmt);
+	if (use_cursor) {
+		snprintf(curid, sizeof(curid), "i_%lX_%d", (unsigned long)(uintptr_t)conn, conn->stmt_cnt);
+		sqli_curs_decl_dynm(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 512), curid, stmt->entry->stmt, 0, 0);
+		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+		if (sqlca.sqlcode != 0) {
+			lua_pushnil(L);
+			pusherrmsg(L, &(conn->conn_sqlca), "declare cursor");
+			lua_pushinteger(L, 1);
+			lua_pushvalue(L, 4);
+			return 4;
 		}
-		pusherrmsg(L, &(conn->conn_sqlca), "fetch cursor");
-		return 2;
+		if (bufsize > 0) {
+			int old_size = FetBufSize;
+			FetBufSize = bufsize;
+			sqli_curs_open(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 768),
+				(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0, 0);
+			FetBufSize = old_size;
+		}
+		else {
+			sqli_curs_open(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 768),
+				(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0, 0);
+		}
+		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+		if (sqlca.sqlcode != 0) {
+			sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
+			lua_pushnil(L);
+			pusherrmsg(L, &(conn->conn_sqlca), "open cursor");
+			lua_pushinteger(L, 1);
+			lua_pushvalue(L, 4);
+			return 4;
+		}
+		curs = sqli_curs_locate(ESQLINTVERSION, curid, 768);
 	}
 
-	if (lua_istable (L, 2)) {
-		const char *opts = luaL_optstring(L, 3, "n");
-
-		if (strchr (opts, 'n') != NULL) {
-			/* Copy values to numerical indices */
-			int i;
-
-			for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
-				pushvalue(L, sqlvar->sqlind, sqlvar->sqltype, sqlvar->sqldata, sqlvar->sqllen);
-				lua_rawseti(L, 2, i+1);
-			}
+	for (i = 1; i <= nrows; i++) {
+		err = bind_row(L, stmt, 2, i);
+		if (err != NULL) {
+			failed = i;
+			break;
 		}
-		if (strchr (opts, 'a') != NULL) {
-			int i;
-
-			for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
-				lua_pushstring(L, sqlvar->sqlname);
-				pushvalue(L, sqlvar->sqlind, sqlvar->sqltype, sqlvar->sqldata, sqlvar->sqllen);
-				lua_rawset(L, 2);
+		if (use_cursor) {
+			sqli_curs_put(ESQLINTVERSION, curs, stmt->in_sqlda, (char *)0);
+		}
+		else {
+			double start = now_seconds();
+			sqli_exec(ESQLINTVERSION, stmt->entry->stmt, stmt->in_sqlda, (char *)0, (struct value *)0,
+				(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0);
+			stat_time(&(conn->stats), STAT_EXECUTE, start);
+		}
+		lua_settop(L, base);
+		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+		if (sqlca.sqlcode != 0) {
+			/* a put reports the rows of the buffer flushed before the error */
+			failed = use_cursor ? (int)(total + batch_rows + sqlca.sqlerrd[2] + 1) : i;
+			hint = use_cursor ? "put row" : "execute sql";
+			break;
+		}
+		batch_rows += sqlca.sqlerrd[2];
+		if ((i % batch == 0) || (i == nrows)) {
+			if (use_cursor) {
+				double start = now_seconds();
+				sqli_curs_flush(ESQLINTVERSION, curs);
+				memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+				stat_time(&(conn->stats), STAT_EXECUTE, start);
+				if (sqlca.sqlcode != 0) {
+					failed = (int)(total + batch_rows + sqlca.sqlerrd[2] + 1);
+					hint = "flush cursor";
+					break;
+				}
+				batch_rows += sqlca.sqlerrd[2];
 			}
+			lua_pushinteger(L, batch_rows);
+			lua_rawseti(L, 4, ++nbatch);
+			total += batch_rows;
+			batch_rows = 0;
 		}
-		lua_pushvalue(L, 2);
-		return 1; /* return table */
 	}
-	else {
-		int i;
-		luaL_checkstack (L, cur->cur_sqlda->sqld, LUASQL_PREFIX"too many columns");
-		for (i = 0, sqlvar = cur->cur_sqlda->sqlvar; i < cur->cur_sqlda->sqld; i++, sqlvar++) {
-			pushvalue(L, sqlvar->sqlind, sqlvar->sqltype, sqlvar->sqldata, sqlvar->sqllen);
+	lua_settop(L, base);
+
+	if (use_cursor) {
+		/* the rows put before a failure reach the table when the buffer
+		   is flushed, a failed put or flush reports the rows it sent */
+		if (err != NULL) {
+			sqli_curs_flush(ESQLINTVERSION, curs);
+			if (sqlca.sqlcode == 0)
+				batch_rows += sqlca.sqlerrd[2];
 		}
-		return cur->cur_sqlda->sqld; /* return value number */
+		else if (failed != 0)
+			batch_rows += conn->conn_sqlca.sqlerrd[2];
+		sqli_curs_close(ESQLINTVERSION, curs);
+		if (sqlca.sqlcode == 0)
+			batch_rows += sqlca.sqlerrd[2];
+		sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
 	}
-}
-
-
-/*
-** The iterator of cursor
-*/
-static int cur_iterator (lua_State *L) {
-	int i;
-
-	lua_pop(L, 1);
-	for (i = 1; !lua_isnone(L, lua_upvalueindex(i)); i++) {
-		lua_pushvalue(L, lua_upvalueindex(i));
+	if (failed != 0) {
+		/* the partial batch before the failing row */
+		if (batch_rows > 0) {
+			lua_pushinteger(L, batch_rows);
+			lua_rawseti(L, 4, ++nbatch);
+		}
+		lua_pushnil(L);
+		if (err != NULL)
+			lua_pushstring(L, err);
+		else if (!readererror(L, stmt))
+			pusherrmsg(L, &(conn->conn_sqlca), hint);
+		lua_pushinteger(L, failed);
+		lua_pushvalue(L, 4);
+		return 4;
 	}
-	return cur_fetch(L);
+	lua_pushinteger(L, total);
+	lua_pushvalue(L, 4);
+	return 2;
 }
 
 
 /*
-** Return the iterator of cursor
+** Return the number of input parameters.
 */
-static int cur_getiter (lua_State *L) {
-	cur_data *cur = getcursor(L);
-	const int num = lua_gettop(L) - 1;
-	int i;
-
-	for (i = 0; i < num; i++) {
-		lua_pushvalue(L, i + 2);		/* push fetch parameter as upvalue */
-	}
-	lua_pushcclosure(L, cur_iterator, num);
-	lua_pushvalue(L, 1);				/* push cursor data*/
-	return 2;
+static int stmt_getparamnum (lua_State *L) {
+	stmt_data *stmt = getstatement(L);
+	lua_pushinteger(L, (stmt->in_sqlda != NULL) ? stmt->in_sqlda->sqld : 0);
+	return 1;
 }
 
 
 /*
-** Cursor object collector function
+** Statement object collector function
 */
-static int cur_gc (lua_State *L) {
-	cur_data *cur = (cur_data *)luaL_checkudata(L, 1, LUASQL_CURSOR_INFORMIX);
-	if (cur != NULL && !(cur->closed))
-		cur_nullify(L, cur);
+static int stmt_gc (lua_State *L) {
+	stmt_data *stmt = (stmt_data *)luaL_checkudata(L, 1, LUASQL_STATEMENT_INFORMIX);
+	if (stmt != NULL && !(stmt->closed))
+		stmt_nullify(L, stmt);
 	return 0;
 }
 
 
 /*
-** Close the cursor on top of the stack.
+** Close the statement on top of the stack.
 ** Return 1
 */
-static int cur_close (lua_State *L) {
-	cur_data *cur = (cur_data *)luaL_checkudata(L, 1, LUASQL_CURSOR_INFORMIX);
-	luaL_argcheck(L, cur != NULL, 1, LUASQL_PREFIX"cursor expected");
-	if (cur->closed) {
+static int stmt_close (lua_State *L) {
+	stmt_data *stmt = (stmt_data *)luaL_checkudata(L, 1, LUASQL_STATEMENT_INFORMIX);
+	luaL_argcheck(L, stmt != NULL, 1, LUASQL_PREFIX"statement expected");
+	if (stmt->closed) {
 		lua_pushboolean(L, 0);
 		return 1;
 	}
-	cur_nullify(L, cur);
+	stmt_nullify(L, stmt);
 	lua_pushboolean(L, 1);
 	return 1;
 }
 
 
 /*
-** Pushes a column information table on top of the stack.
-** If the table isn't built yet, call the creator function and stores
-** a reference to it on the cursor structure.
+** State of a running conn:load.
+** Raw records are kept in pend until a flush confirms them, so rows after
+** a failing one in the insert buffer can be put again and the failing
+** one can be written to the reject file.
 */
-static void _pushtable (lua_State *L, cur_data *cur, size_t off) {
-	int *ref = (int *)((char *)cur + off);
-
-	/* If colnames or coltypes do not exist, create both. */
-	if (*ref == LUA_NOREF)
-		create_colinfo(L, cur);
-	
-	/* Pushes the right table (colnames or coltypes) */
-	lua_rawgeti (L, LUA_REGISTRYINDEX, *ref);
-}
-#define pushtable(L,c,m) (_pushtable(L,c,offsetof(cur_data,m)))
+typedef struct {
+	conn_data *conn;
+	ifx_cursor_t *curs;			/* insert cursor */
+	ifx_sqlda_t *sqlda;			/* one string parameter per column */
+	int		ncols;
+	char	delim;
+	char	esc;				/* escape character, 0 if none */
+	FILE	*reject;			/* reject file, may be NULL */
+	long	maxerrors;			/* max rejected rows, -1 for no limit */
+	char	*pend;				/* raw records not confirmed yet */
+	size_t	pend_len, pend_size;
+	size_t	*pend_off;			/* start offset of each pending record */
+	int		npend, pend_max;
+	int		confirmed;			/* pending records done, inserted or rejected */
+	char	*scratch;			/* record being parsed */
+	size_t	scratch_size;
+	char	**fields;
+	long	rows, rejected;
+} load_ctx;
 
 
 /*
-** Return the list of field names.
+** Find the end of the record starting at p, honouring escapes.
+** Return the record length without the newline, or -1 if there is no
+** complete record before end. *ndelim gets the number of delimiters,
+** *trailing whether the record ends with a delimiter.
 */
-static int cur_getcolnames (lua_State *L) {
-	pushtable(L, getcursor(L), colnames);
-	return 1;
+static long load_scan (load_ctx *ctx, const char *p, const char *end, int *ndelim, int *trailing) {
+	const char *q = p;
+	int n = 0, last = 0;
+
+	while (q < end) {
+		char c = *q;
+		if ((c == ctx->esc) && (ctx->esc != 0)) {
+			if (q + 1 >= end)
+				return -1;
+			q += 2;
+			last = 0;
+			continue;
+		}
+		if (c == '\n') {
+			long len = q - p;
+			if ((len > 0) && (q[-1] == '\r'))
+				len--;
+			*ndelim = n;
+			*trailing = last;
+			return len;
+		}
+		if (c == ctx->delim) {
+			n++;
+			last = 1;
+		}
+		else if (c != '\r') {
+			last = 0;
+		}
+		q++;
+	}
+	return -1;
 }
 
 
 /*
-** Return the list of field types.
+** Split a record in place into ctx->fields, removing escapes.
+** Empty fields are stored as NULL.
 */
-static int cur_getcoltypes (lua_State *L) {
-	pushtable(L, getcursor(L), coltypes);
-	return 1;
+static void load_split (load_ctx *ctx, char *rec, size_t len) {
+	char *r = rec, *w = rec, *end = rec + len, *field = rec;
+	int n = 0;
+
+	while ((r < end) && (n < ctx->ncols)) {
+		if ((*r == ctx->esc) && (ctx->esc != 0) && (r + 1 < end)) {
+			*(w++) = r[1];
+			r += 2;
+		}
+		else if (*r == ctx->delim) {
+			*w = '\0';
+			ctx->fields[n++] = (w == field) ? NULL : field;
+			field = ++w;
+			r++;
+		}
+		else {
+			*(w++) = *(r++);
+		}
+	}
+	if (n < ctx->ncols) {
+		/* last field without a trailing delimiter */
+		*w = '\0';
+		ctx->fields[n++] = (w == field) ? NULL : field;
+	}
 }
 
 
 /*
-** Return the field num.
+** Write a raw record to the reject file.
 */
-static int cur_getfieldnum (lua_State *L) {
-	cur_data *cur = getcursor(L);
-	lua_pushinteger(L, cur->cur_sqlda->sqld);
-	return 1;
+static void load_reject (load_ctx *ctx, const char *rec, size_t len) {
+	ctx->rejected++;
+	if (ctx->reject != NULL) {
+		fwrite(rec, 1, len, ctx->reject);
+		fputc('\n', ctx->reject);
+	}
 }
 
 
 /*
-** Create a new Cursor object and push it on top of the stack.
+** Length of pending record i.
 */
-static int create_cursor (lua_State *L, int conn, char *curid, ifx_sqlda_t *sqlda, char *buf, int2 *ind) {
-	cur_data *cur = (cur_data *)lua_newuserdata(L, sizeof(cur_data));
-	luasql_setmeta(L, LUASQL_CURSOR_INFORMIX);
-
-	/* fill in structure */
-	cur->closed = 0;
-	cur->conn = LUA_NOREF;
-	cur->colnames = LUA_NOREF;
-	cur->coltypes = LUA_NOREF;
-	strncpy(cur->cur_name,curid,sizeof(cur->cur_name));
-	cur->cur_sqlda = sqlda;
-	cur->buf = buf;
-	cur->indicators = ind;
-	lua_pushvalue (L, conn);
-	cur->conn = luaL_ref(L, LUA_REGISTRYINDEX);
-
-	return 1;
+static size_t load_pend_len (load_ctx *ctx, int i) {
+	size_t next = (i + 1 < ctx->npend) ? ctx->pend_off[i + 1] : ctx->pend_len;
+	return next - ctx->pend_off[i];
 }
 
 
-static int conn_gc (lua_State *L) {
-	conn_data *conn=(conn_data *)luaL_checkudata(L, 1, LUASQL_CONNECTION_INFORMIX);
-	if (conn != NULL && !(conn->closed)) {
-		set_conn(L, conn);
-		sqli_trans_rollback();
-		sqli_connect_close(0, conn->conn_name, 0, 0);
-
-		/* Nullify structure fields. */
-		conn->closed = 1;
-		luaL_unref(L, LUA_REGISTRYINDEX, conn->env);
+/*
+** Append a raw record to the pending list.
+*/
+static int load_pend_add (load_ctx *ctx, const char *rec, size_t len) {
+	if (ctx->pend_len + len > ctx->pend_size) {
+		size_t size = (ctx->pend_size + len) * 2;
+		char *p = (char *)realloc(ctx->pend, size);
+		if (p == NULL)
+			return -1;
+		ctx->pend = p;
+		ctx->pend_size = size;
+	}
+	if (ctx->npend >= ctx->pend_max) {
+		int max = ctx->pend_max * 2 + 16;
+		size_t *off = (size_t *)realloc(ctx->pend_off, max * sizeof(size_t));
+		if (off == NULL)
+			return -1;
+		ctx->pend_off = off;
+		ctx->pend_max = max;
 	}
+	ctx->pend_off[ctx->npend++] = ctx->pend_len;
+	memcpy(ctx->pend + ctx->pend_len, rec, len);
+	ctx->pend_len += len;
 	return 0;
 }
 
 
 /*
-** Close a Connection object.
+** Parse pending record i and put it into the insert cursor.
 */
-static int conn_close (lua_State *L) {
-	conn_data *conn=(conn_data *)luaL_checkudata(L, 1, LUASQL_CONNECTION_INFORMIX);
-	luaL_argcheck(L, conn != NULL, 1, LUASQL_PREFIX"connection expected");
-	if (conn->closed) {
-		lua_pushboolean(L, 0);
-		return 1;
+static int load_put (load_ctx *ctx, int i) {
+	size_t len = load_pend_len(ctx, i);
+	ifx_sqlvar_t *sqlvar = NULL;
+	int j;
+
+	if (len + 1 > ctx->scratch_size) {
+		char *p = (char *)realloc(ctx->scratch, len + 1);
+		if (p == NULL)
+			return -1;
+		ctx->scratch = p;
+		ctx->scratch_size = len + 1;
 	}
-	conn_gc(L);
-	lua_pushboolean(L, 1);
-	return 1;
+	memcpy(ctx->scratch, ctx->pend + ctx->pend_off[i], len);
+	load_split(ctx, ctx->scratch, len);
+	for (j = 0, sqlvar = ctx->sqlda->sqlvar; j < ctx->ncols; j++, sqlvar++) {
+		if (ctx->fields[j] == NULL) {
+			*(sqlvar->sqlind) = -1;
+			sqlvar->sqldata = "";
+			sqlvar->sqllen = 1;
+		}
+		else {
+			*(sqlvar->sqlind) = 0;
+			sqlvar->sqldata = ctx->fields[j];
+			sqlvar->sqllen = strlen(ctx->fields[j]) + 1;
+		}
+	}
+	sqli_curs_put(ESQLINTVERSION, ctx->curs, ctx->sqlda, (char *)0);
+	return 0;
 }
 
 
 /*
-** Alloc buffer from description sqlda struct
+** Handle a failed put or flush: the server inserted `inserted' rows of
+** the buffer, the next one failed and goes to the reject file.
+** The insert buffer is empty afterwards, so the records after the
+** failing one must be put again.
 */
-static int alloc_buf (ifx_sqlda_t *sqlda, char **p_buf, int2 **p_ind) {
-	int i;
-	int c,len = 0;
-	char *buf = NULL, *p = NULL;
-	ifx_sqlvar_t *sqlvar = NULL;
-	int2 *ind;
-
-	for (i = 0, sqlvar = sqlda->sqlvar; i < sqlda->sqld; i++, sqlvar++) {
-		c = sqlvar->sqltype;
-		toctype(sqlvar->sqltype, c);
-
-		/* deal UDT type */
-		if (ISUDTTYPE(c)) {
-			switch(sqlvar->sqlxid) {
-				case XID_BLOB:
-				case XID_CLOB:
-					sqlvar->sqltype = CLOCATORTYPE;
-					sqlvar->sqllen = sizeof(ifx_loc_t);
-					break;
-				default:
-					sqlvar->sqltype = CSTRINGTYPE;
-					sqlvar->sqllen = 2048;			/* default length, data may imcomplete */
-			}
-		}
+static int load_failed (load_ctx *ctx, int inserted, int last) {
+	int k = ctx->confirmed + inserted;
+
+	memcpy(&(ctx->conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (k > last)
+		k = last;
+	ctx->rows += k - ctx->confirmed;
+	load_reject(ctx, ctx->pend + ctx->pend_off[k], load_pend_len(ctx, k));
+	ctx->confirmed = k + 1;
+	if ((ctx->maxerrors >= 0) && (ctx->rejected > ctx->maxerrors))
+		return -1;
+	return 0;
+}
 
-		/* SQLLVARCHAR convert to c style string type CSTRINGTYPE */
-		if (c == SQLLVARCHAR)
-			sqlvar->sqltype = CSTRINGTYPE;
 
-		len = rtypalign(len, sqlvar->sqltype) + rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
-	}
-	buf = (char *)malloc(len+1);
-	if (buf == NULL) {
-		return -1;
-	}
-	ind = (int2 *)calloc(sqlda->sqld,sizeof(int2));
-	if (ind == NULL) {
-		free(buf);
-		return -1;
+/*
+** Put the pending records from index i on.
+*/
+static int load_put_from (load_ctx *ctx, int i) {
+	while (i < ctx->npend) {
+		if (load_put(ctx, i) != 0)
+			return -1;
+		if (sqlca.sqlcode == 0) {
+			ctx->confirmed += sqlca.sqlerrd[2];
+			ctx->rows += sqlca.sqlerrd[2];
+			i++;
+			continue;
+		}
+		if (load_failed(ctx, sqlca.sqlerrd[2], i) != 0)
+			return -1;
+		i = ctx->confirmed;
 	}
-	*p_buf = buf;
-	*p_ind = ind;
-	memset(buf, 0, len+1);
-	for (i = 0, sqlvar = sqlda->sqlvar, p = buf; i < sqlda->sqld; i++, sqlvar++, ind++) {
-		p = (char *)rtypalign((mlong)p, sqlvar->sqltype);
-		sqlvar->sqldata = p;
-		p += rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
+	return 0;
+}
 
-		/* adjust type length except datetime and decimal type */
-		if ((sqlvar->sqltype != CDTIMETYPE)&&
-			(sqlvar->sqltype != CINVTYPE)&&
-			(sqlvar->sqltype != CDECIMALTYPE)&&
-			(sqlvar->sqltype != CMONEYTYPE)) {
-				sqlvar->sqllen=rtypmsize(sqlvar->sqltype, sqlvar->sqllen);
-		}
 
-		/* setup locator type */
-		if (sqlvar->sqltype == CLOCATORTYPE) {
-			ifx_loc_t *loc = (ifx_loc_t *)sqlvar->sqldata;
-			loc->loc_loctype = LOCMEMORY;
-			loc->loc_bufsize = -1;
-			loc->loc_oflags = 0;
-			loc->loc_mflags = LOC_ALLOC;
+/*
+** Flush the insert cursor and forget the pending records.
+*/
+static int load_flush (load_ctx *ctx) {
+	while (ctx->confirmed < ctx->npend) {
+		sqli_curs_flush(ESQLINTVERSION, ctx->curs);
+		if (sqlca.sqlcode == 0) {
+			ctx->rows += sqlca.sqlerrd[2];
+			break;
 		}
-
-		sqlvar->sqlind = ind;
+		if (load_failed(ctx, sqlca.sqlerrd[2], ctx->npend - 1) != 0)
+			return -1;
+		if (load_put_from(ctx, ctx->confirmed) != 0)
+			return -1;
 	}
-
+	ctx->npend = 0;
+	ctx->pend_len = 0;
+	ctx->confirmed = 0;
 	return 0;
 }
 
 
 /*
-** Execute an SQL statement.
-** Return a Cursor object if the statement is a query, otherwise
-** return the number of tuples affected by the statement.
+** Count the columns of the table, or of the column list.
+** Return -1 and leave the error in conn_sqlca on failure.
 */
-static int conn_execute (lua_State *L) {
+static int load_ncols (lua_State *L, conn_data *conn, const char *table, const char *columns) {
+	stmt_entry *entry;
+	const char *sql;
+	size_t len;
+	int ncols;
+
+	lua_pushfstring(L, "SELECT %s FROM %s", (columns != NULL) ? columns : "*", table);
+	sql = lua_tolstring(L, -1, &len);
+	entry = stmt_prepare(L, conn, sql, len, 0);
+	lua_pop(L, 1);
+	if (entry == NULL)
+		return -1;
+	ncols = (entry->sqlda != NULL) ? entry->sqlda->sqld : 0;
+	stmt_free(L, entry);
+	return ncols;
+}
+
+
+/*
+** Load a delimited (UNL) file into a table through an insert cursor,
+** without creating Lua values for the fields.
+** Options: delimiter (default DBDELIMITER or '|'), escape (default '\',
+** false for none), columns (column list), commit (rows per transaction,
+** 0 leaves transactions alone), batch (rows per flush), reject (path of
+** the reject file), maxerrors (max rejected rows).
+** With autocommit off the rows go in the transaction of the caller, who
+** commits or rolls them back; commit is ignored.
+** Return a table with rows, rejected, seconds and rows_per_sec, or nil,
+** the error message and that table.
+*/
+static int conn_load (lua_State *L) {
 	conn_data *conn = getconnection(L);
-	size_t st_len;
-	const char *statement = luaL_checklstring(L, 2, &st_len);
-	char prepid[64];
-	ifx_sqlda_t *sqlda=NULL;
-	ifx_cursor_t *pStmt=NULL;
+	const char *path = luaL_checkstring(L, 2);
+	const char *table = luaL_checkstring(L, 3);
+	const char *columns = NULL, *reject = NULL, *str = NULL, *sql;
+	int commit, batch, trans = 0, ret = 0, eof = 0;
+	long since_commit = 0;
+	double start = now_seconds(), elapsed;
+	char curid[64];
+	char *err = NULL, *hint = NULL;
+	char *rbuf = NULL;
+	size_t rsize = LOAD_READ_SIZE, rstart = 0, rend = 0, len;
+	stmt_entry *entry = NULL;
+	FILE *fp = NULL;
+	load_ctx ctx;
+	int i;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.conn = conn;
+	ctx.delim = (getenv("DBDELIMITER") != NULL) ? getenv("DBDELIMITER")[0] : '|';
+	ctx.esc = '\\';
+	ctx.maxerrors = getoptint(L, 4, "maxerrors", -1);
+	commit = getoptint(L, 4, "commit", 0);
+	batch = getoptint(L, 4, "batch", LOAD_BATCH_SIZE);
+	if (batch <= 0)
+		batch = LOAD_BATCH_SIZE;
+	if ((commit > 0) && (commit < batch))
+		batch = commit;
+	if (lua_istable(L, 4)) {
+		lua_getfield(L, 4, "delimiter");
+		if ((str = lua_tostring(L, -1)) != NULL)
+			ctx.delim = str[0];
+		lua_getfield(L, 4, "escape");
+		if (lua_isboolean(L, -1) && !lua_toboolean(L, -1))
+			ctx.esc = 0;
+		else if ((str = lua_tostring(L, -1)) != NULL)
+			ctx.esc = str[0];
+		lua_getfield(L, 4, "columns");
+		columns = lua_tostring(L, -1);
+		lua_getfield(L, 4, "reject");
+		reject = lua_tostring(L, -1);
+		/* the option strings stay on the stack while loading */
+	}
+	luaL_argcheck(L, (ctx.delim != '\n') && (ctx.delim != ctx.esc), 4, "invalid delimiter");
 
 	set_conn(L, conn);
 	conn->stmt_cnt++;
-	snprintf(prepid, sizeof(prepid), "p_%lX_%d", conn, conn->stmt_cnt);
-	pStmt = sqli_prep(ESQLINTVERSION, prepid, statement, (ifx_literal_t *)0, (ifx_namelist_t *)0, -1, 0, 0 );
+	ctx.ncols = load_ncols(L, conn, table, columns);
+	if (ctx.ncols <= 0) {
+		hint = "describe table";
+		goto done;
+	}
+
+	/* build the insert statement and its input sqlda */
+	luaL_checkstack(L, 2 * ctx.ncols + 4, LUASQL_PREFIX"too many columns");
+	if (columns != NULL)
+		lua_pushfstring(L, "INSERT INTO %s (%s) VALUES (", table, columns);
+	else
+		lua_pushfstring(L, "INSERT INTO %s VALUES (", table);
+	for (i = 0; i < ctx.ncols; i++)
+		lua_pushstring(L, (i == 0) ? "?" : ",?");
+	lua_pushstring(L, ")");
+	lua_concat(L, ctx.ncols + 2);
+	sql = lua_tolstring(L, -1, &len);
+	entry = stmt_prepare(L, conn, sql, len, 0);
+	result_written(L, conn, sql, len);
+	lua_pop(L, 1);
+	if (entry == NULL) {
+		hint = "prepare sql";
+		goto done;
+	}
+	ctx.sqlda = (ifx_sqlda_t *)calloc(1, sizeof(ifx_sqlda_t) +
+		ctx.ncols * (sizeof(ifx_sqlvar_t) + sizeof(int2) + sizeof(char *)));
+	rbuf = (char *)malloc(rsize);
+	if ((ctx.sqlda == NULL) || (rbuf == NULL)) {
+		err = "alloc memory fail";
+		goto done;
+	}
+	ctx.sqlda->sqld = ctx.ncols;
+	ctx.sqlda->sqlvar = (ifx_sqlvar_t *)(ctx.sqlda + 1);
+	ctx.fields = (char **)(ctx.sqlda->sqlvar + ctx.ncols);
+	for (i = 0; i < ctx.ncols; i++) {
+		ctx.sqlda->sqlvar[i].sqltype = CSTRINGTYPE;
+		ctx.sqlda->sqlvar[i].sqlind = (int2 *)(ctx.fields + ctx.ncols) + i;
+	}
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		err = "open load file fail";
+		goto done;
+	}
+	if (reject != NULL) {
+		ctx.reject = fopen(reject, "wb");
+		if (ctx.reject == NULL) {
+			err = "open reject file fail";
+			goto done;
+		}
+	}
+
+	/* transactions of the commit interval, the transaction of the caller
+	   is left alone */
+	if ((commit > 0) && (conn->auto_commit == 1)) {
+		sqli_trans_begin2((mint)1);
+		trans = (sqlca.sqlcode == 0);	/* no transactions in an unlogged database */
+	}
+
+	/* declare and open the insert cursor */
+	snprintf(curid, sizeof(curid), "i_%lX_%d", (unsigned long)(uintptr_t)conn, conn->stmt_cnt);
+	sqli_curs_decl_dynm(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 512), curid, entry->stmt, 4096, 0);
 	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
 	if (sqlca.sqlcode != 0) {
-		lua_pushnil(L);
-		pusherrmsg(L, &(conn->conn_sqlca), "prepare sql");
-		return 2;
+		hint = "declare cursor";
+		goto done;
+	}
+	ctx.curs = sqli_curs_locate(ESQLINTVERSION, curid, 768);
+	sqli_curs_open(ESQLINTVERSION, ctx.curs, (ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0, 0);
+	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (sqlca.sqlcode != 0) {
+		sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
+		ctx.curs = NULL;
+		hint = "open cursor";
+		goto done;
 	}
 
-	sqli_describe_stmt(ESQLINTVERSION, pStmt, &sqlda, 0);
-	if (sqlda->sqld == 0) {
-		/* not query, execute the sql statment */
-		free(sqlda);
-		sqli_exec(ESQLINTVERSION, pStmt, (ifx_sqlda_t *)0, (char *)0, (struct value *)0,
-			(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0);
-		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
-		if (sqlca.sqlcode != 0) {
-			/* execute sql fail */
-			lua_pushnil(L);
+	while (!eof || (rstart < rend)) {
+		int ndelim, trailing;
+		long len = -1;
+
+		if (rstart < rend)
+			len = load_scan(&ctx, rbuf + rstart, rbuf + rend, &ndelim, &trailing);
+		if (len < 0) {
+			if (eof) {
+				/* incomplete record at the end of the file */
+				load_reject(&ctx, rbuf + rstart, rend - rstart);
+				rstart = rend;
+				continue;
+			}
+			/* move the partial record to the front and read more */
+			memmove(rbuf, rbuf + rstart, rend - rstart);
+			rend -= rstart;
+			rstart = 0;
+			if (rend + 1 >= rsize) {
+				char *p = (char *)realloc(rbuf, rsize * 2);
+				if (p == NULL) {
+					err = "alloc memory fail";
+					break;
+				}
+				rbuf = p;
+				rsize *= 2;
+			}
+			rend += fread(rbuf + rend, 1, rsize - rend - 1, fp);
+			if (feof(fp) || ferror(fp)) {
+				eof = 1;
+				/* the last record may lack its newline */
+				if ((rend > 0) && (rbuf[rend - 1] != '\n'))
+					rbuf[rend++] = '\n';
+			}
+			continue;
+		}
+
+		if (len == 0) {
+			/* skip empty lines */
+		}
+		else if (((ndelim == ctx.ncols) && trailing) || (ndelim + 1 == ctx.ncols)) {
+			if ((load_pend_add(&ctx, rbuf + rstart, len) != 0) ||
+				(load_put_from(&ctx, ctx.npend - 1) != 0)) {
+				ret = -1;
+			}
 		}
 		else {
-			/* return affected rows */
-			lua_pushinteger(L, sqlca.sqlerrd[2]);
+			load_reject(&ctx, rbuf + rstart, len);
+			if ((ctx.maxerrors >= 0) && (ctx.rejected > ctx.maxerrors))
+				ret = -1;
 		}
-		sqli_curs_free(ESQLINTVERSION, pStmt);
-		pusherrmsg(L, &(conn->conn_sqlca), "execute sql");
-		return 2;
-	}
-	else { /* return tuples */
-		char curid[64];
-		char *buf = NULL;
-		int2 *ind = NULL;
-
-		snprintf(curid, sizeof(curid), "c_%lX_%d", conn, conn->stmt_cnt);
-
-		/* alloc buf for sqlda */
-		if (alloc_buf(sqlda, &buf, &ind) != 0) {
-			free(sqlda);
-			sqli_curs_free(ESQLINTVERSION, pStmt);
-			lua_pushnil(L);
-			lua_pushstring(L, "alloc fetch buffer fail");
-			return 2;
+		rstart += len + 1;
+		while ((rstart < rend) && (rbuf[rstart - 1] != '\n'))
+			rstart++;			/* skip the '\r' of a CRLF line end */
+
+		if ((ret == 0) && (ctx.npend >= batch)) {
+			long rows = ctx.rows;
+			ret = load_flush(&ctx);
+			since_commit += ctx.rows - rows;
+			if ((ret == 0) && trans && (since_commit >= commit)) {
+				sqli_trans_commit();
+				if (sqlca.sqlcode == 0)
+					sqli_trans_begin2((mint)1);
+				if (sqlca.sqlcode != 0) {
+					memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+					hint = "commit transaction";
+					trans = 0;
+					break;
+				}
+				since_commit = 0;
+			}
 		}
-
-		/* declare cursor with hold */
-		sqli_curs_decl_dynm(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 512), curid, pStmt, 4096, 0);
-		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
-		if (sqlca.sqlcode != 0) {
-			free(buf);
-			free(ind);
-			free(sqlda);
-			sqli_curs_free(ESQLINTVERSION, pStmt);
-			lua_pushnil(L);
-			pusherrmsg(L, &(conn->conn_sqlca), "declare cursor");
-			return 2;
+		if (ret != 0) {
+			if ((ctx.maxerrors >= 0) && (ctx.rejected > ctx.maxerrors))
+				err = "too many rejected rows";
+			else if (err == NULL)
+				err = "alloc memory fail";
+			break;
 		}
-		sqli_curs_free(ESQLINTVERSION, pStmt);
-
-		/* open cursor */
-		sqli_curs_open(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 768),
-			(ifx_sqlda_t *)0, (char *)0, (struct value *)0, 0, 0);
-		memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
-		if (sqlca.sqlcode != 0) {
-			free(buf);
-			free(ind);
-			free(sqlda);
-			sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
-			lua_pushnil(L);
-			pusherrmsg(L, &(conn->conn_sqlca), "open cursor");
-			return 2;
+	}
+	if ((err == NULL) && (hint == NULL) && (load_flush(&ctx) != 0))
+		err = "too many rejected rows";
+	/* closing flushes the rows still buffered when the loop stopped early */
+	sqli_curs_close(ESQLINTVERSION, ctx.curs);
+	if (sqlca.sqlcode == 0)
+		ctx.rows += sqlca.sqlerrd[2];
+	sqli_curs_free(ESQLINTVERSION, sqli_curs_locate(ESQLINTVERSION, curid, 770));
+
+done:
+	if (trans) {
+		if ((err == NULL) && (hint == NULL)) {
+			sqli_trans_commit();
+			if (sqlca.sqlcode != 0) {
+				memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+				hint = "commit transaction";
+			}
+		}
+		else {
+			sqli_trans_rollback();
 		}
-
-		return create_cursor(L, 1, curid, sqlda, buf, ind);
 	}
+	if (entry != NULL)
+		stmt_free(L, entry);
+	if (fp != NULL)
+		fclose(fp);
+	if (ctx.reject != NULL)
+		fclose(ctx.reject);
+	free(rbuf);
+	free(ctx.sqlda);
+	free(ctx.pend);
+	free(ctx.pend_off);
+	free(ctx.scratch);
+
+	elapsed = now_seconds() - start;
+	lua_newtable(L);
+	lua_pushstring(L, "rows");
+	lua_pushinteger(L, ctx.rows);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "rejected");
+	lua_pushinteger(L, ctx.rejected);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "seconds");
+	lua_pushnumber(L, elapsed);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "rows_per_sec");
+	lua_pushnumber(L, (elapsed > 0) ? ctx.rows / elapsed : 0);
+	lua_rawset(L, -3);
+	if ((err == NULL) && (hint == NULL))
+		return 1;
+	lua_pushnil(L);
+	if (err != NULL)
+		lua_pushstring(L, err);
+	else
+		pusherrmsg(L, &(conn->conn_sqlca), hint);
+	lua_pushvalue(L, -3);
+	return 3;
 }
 
 
@@ -786,10 +6299,14 @@ static int conn_execute (lua_State *L) {
 */
 static int conn_transbegin (lua_State *L) {
 	conn_data *conn = getconnection (L);
+	double start;
+
 	set_conn(L, conn);
+	start = now_seconds();
 	sqli_trans_begin2((mint)1);
 	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
-	if (sqlca.sqlcode != 0) {
+	query_event(L, conn, "begin work", 10, now_seconds() - start, 0, conn->conn_sqlca.sqlcode);
+	if (conn->conn_sqlca.sqlcode != 0) {
 		lua_pushboolean(L, 0);
 		pusherrmsg(L, &(conn->conn_sqlca), "begin transaction");
 		return 2;
@@ -806,15 +6323,20 @@ static int conn_transbegin (lua_State *L) {
 */
 static int conn_commit (lua_State *L) {
 	conn_data *conn = getconnection (L);
+	double start;
 
 	if (conn->auto_commit == 1) {
 		lua_pushboolean(L, 1);
 		return 1;
 	}
 	set_conn(L, conn);
+	start = now_seconds();
 	sqli_trans_commit();
 	memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
-	if (sqlca.sqlcode != 0) {
+	stat_time(&(conn->stats), STAT_COMMIT, start);
+	query_event(L, conn, "commit work", 11, now_seconds() - start, 0, conn->conn_sqlca.sqlcode);
+	result_txn_end(L, conn);
+	if (conn->conn_sqlca.sqlcode != 0) {
 		lua_pushboolean(L, 0);
 		pusherrmsg(L, &(conn->conn_sqlca), "commit transaction");
 		return 2;
@@ -838,6 +6360,7 @@ static int conn_commit (lua_State *L) {
 */
 static int conn_rollback (lua_State *L) {
 	conn_data *conn = getconnection (L);
+	double start;
 
 	if (conn->auto_commit == 1) {
 		lua_pushboolean(L, 0);
@@ -845,9 +6368,13 @@ static int conn_rollback (lua_State *L) {
 		return 2;
 	}
 	set_conn(L, conn);
+	start = now_seconds();
 	sqli_trans_rollback();
 	memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
-	if (sqlca.sqlcode != 0) {
+	stat_time(&(conn->stats), STAT_ROLLBACK, start);
+	query_event(L, conn, "rollback work", 13, now_seconds() - start, 0, conn->conn_sqlca.sqlcode);
+	result_txn_end(L, conn);
+	if (conn->conn_sqlca.sqlcode != 0) {
 		lua_pushboolean(L, 0);
 		pusherrmsg(L, &(conn->conn_sqlca), "rollback transaction");
 		return 2;
@@ -879,6 +6406,7 @@ static int conn_setautocommit (lua_State *L)
 	{
 		/* undo active transaction - ignore errors */
 		sqli_trans_rollback();
+		result_txn_end(L, conn);
 		lua_pushboolean(L, 1);
 		conn->auto_commit = 1;
 		conn->auto_begin = 0;
@@ -1024,6 +6552,17 @@ static int inttodate (lua_State *L) {
 }
 
 
+/*
+** Fetch options of a new connection.
+*/
+static void default_opts (fetch_opts *opts) {
+	opts->decimal = DEC_NUMBER;
+	opts->trim = 1;
+	opts->temporal = 0;
+	opts->lob = 0;
+}
+
+
 /*
 ** Create a new Connection object and push it on top of the stack.
 */
@@ -1038,31 +6577,68 @@ static int create_connection (lua_State *L, int env, const char *conn_id) {
 	conn->stmt_cnt = 0;
 	conn->auto_commit = 1;
 	conn->auto_begin = 0;
+	memset(&(conn->cache), 0, sizeof(stmt_cache));
+	conn->arenas = NULL;
+	conn->narenas = 0;
+	conn->switches = 0;
+	conn->switches_skipped = 0;
+	conn->lookups_skipped = 0;
+	conn->pool = LUA_NOREF;
+	conn->pool_idle = 0;
+	conn->idle_since = 0;
+	conn->async = NULL;
+	conn->timeout = 0;
+	conn->deadline = 0;
+	conn->cancel = 0;
+	conn->broken = NULL;
+	conn->envp = (env_data *)lua_touserdata(L, env);
+	conn->hook = LUA_NOREF;
+	conn->slow = SLOW_THRESHOLD;
+	conn->trace = NULL;
+	conn->trace_start = 0;
+	conn->trace_ids = 0;
+	conn->trace_failed = 0;
+	conn->dbkey[0] = '\0';
+	conn->written = LUA_NOREF;
+	conn->generation = 0;
+	memset(&(conn->stats), 0, sizeof(conn_stats));
+	conn->timing = &(conn->stats);
+	active_conn = conn;			/* connecting makes it current */
+	sqlbreakcallback(BREAK_TICK_MS, break_callback);
+	LOCK_CONN_LIST();
+	conn->list_next = conn_list;
+	conn_list = conn;
+	UNLOCK_CONN_LIST();
+	default_opts(&(conn->opts));
 	lua_pushvalue(L, env);
 	conn->env = luaL_ref(L, LUA_REGISTRYINDEX);
 	memcpy(&(conn->conn_sqlca),&sqlca,sizeof(ifx_sqlca_t));
+	if (stmt_cache_resize(L, &(conn->cache), STMT_CACHE_SIZE) != 0) {
+		conn->cache.size = 0;
+	}
 
 	return 1;
 }
 
 
 /*
-** Connects to a database
+** Open a connection of the environment at index env and push it, or
+** push nil and an error message.
 */
-static int env_connect (lua_State *L) {
-	int r;
-	env_data *env = getenvironment(L);
-	const char *dbname = luaL_checkstring(L, 2);
-	const char *username = luaL_optstring(L, 3, NULL);
-	const char *password = luaL_optstring(L, 4, NULL);
+static int open_connection (lua_State *L, int env, const char *dbname, const char *username, const char *password) {
+	env_data *env_p = (env_data *)lua_touserdata(L, env);
 	char connid[MAX_NAME_LENGTH];
+	char target[MAX_NAME_LENGTH*2+2];
 	ifx_conn_t *_sqiconn;
+	conn_data *conn;
 
-	if (set_env(env) != 0) {
-		return luasql_faildirect(L, "set informix server environment fail");
+	/* name the server in the target, the environment is process wide */
+	if ((env_p->server[0] != '\0') && (strchr(dbname, '@') == NULL)) {
+		snprintf(target, sizeof(target), "%s@%s", dbname, env_p->server);
+		dbname = target;
 	}
-	env->conn_cnt++;
-	snprintf(connid, sizeof(connid), "C_%lX_%d", env, env->conn_cnt);
+	env_p->conn_cnt++;
+	snprintf(connid, sizeof(connid), "C_%lX_%d", (unsigned long)(uintptr_t)env_p, env_p->conn_cnt);
 	/* Try to connect the database */
 	if (username != NULL)
 	{
@@ -1075,14 +6651,586 @@ static int env_connect (lua_State *L) {
 		sqli_connect_open(ESQLINTVERSION, 0, dbname, connid, (ifx_conn_t *)0, 1);
 	}
 	if (sqlca.sqlcode != 0) {
+		active_conn = NULL;
 		lua_pushnil(L);
 		pusherrmsg(L, &sqlca, "connect db");
 		return 2;
 	}
-	if (restore_env(env) != 0) {
-		return luasql_faildirect(L, "set informix server environment fail");
+	create_connection(L, env, connid);
+	conn = (conn_data *)lua_touserdata(L, -1);
+	snprintf(conn->dbkey, sizeof(conn->dbkey), "%s;%s", dbname, (username != NULL) ? username : "");
+	return 1;
+}
+
+
+/*
+** Connects to a database
+*/
+static int env_connect (lua_State *L) {
+	const char *dbname, *username, *password;
+
+	getenvironment(L);
+	dbname = luaL_checkstring(L, 2);
+	username = luaL_optstring(L, 3, NULL);
+	password = luaL_optstring(L, 4, NULL);
+	return open_connection(L, 1, dbname, username, password);
+}
+
+
+/*
+** Check for valid pool.
+*/
+static pool_data *getpool (lua_State *L) {
+	pool_data *pool = (pool_data *)luaL_checkudata(L, 1, LUASQL_POOL_INFORMIX);
+	luaL_argcheck(L, pool != NULL, 1, "pool expected");
+	luaL_argcheck(L, !pool->closed, 1, "pool is closed");
+	return pool;
+}
+
+
+/*
+** Open a connection for the pool at index 1 and push it, or push nil
+** and an error message.
+*/
+static int pool_open (lua_State *L, pool_data *pool) {
+	env_data *env = getenvfromref(L, pool->env);
+	conn_data *conn;
+	int top = lua_gettop(L);
+
+	if (env->closed) {
+		lua_pushnil(L);
+		lua_pushstring(L, LUASQL_PREFIX"environment is closed");
+		return 2;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pool->env);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pool->login);
+	lua_rawgeti(L, -1, 1);
+	lua_rawgeti(L, -2, 2);
+	lua_rawgeti(L, -3, 3);
+	if (open_connection(L, top + 1, lua_tostring(L, -3), lua_tostring(L, -2), lua_tostring(L, -1)) != 1) {
+		lua_replace(L, top + 2);
+		lua_replace(L, top + 1);
+		lua_settop(L, top + 2);
+		return 2;
+	}
+	lua_replace(L, top + 1);
+	lua_settop(L, top + 1);
+	conn = (conn_data *)lua_touserdata(L, -1);
+	lua_pushvalue(L, 1);
+	conn->pool = luaL_ref(L, LUA_REGISTRYINDEX);
+	pool->busy++;
+	pool->opened++;
+	return 1;
+}
+
+
+/*
+** Check a connection still talks to its server: preparing a statement
+** costs one round trip and runs nothing.
+*/
+static int conn_ping (lua_State *L, conn_data *conn) {
+	ifx_cursor_t *stmt;
+	char prepid[64];
+
+	set_conn(L, conn);
+	if (active_conn != conn)
+		return 0;
+	snprintf(prepid, sizeof(prepid), "q_%lX", (unsigned long)(uintptr_t)conn);
+	stmt = sqli_prep(ESQLINTVERSION, prepid, POOL_PING_SQL, (ifx_literal_t *)0, (ifx_namelist_t *)0, -1, 0, 0 );
+	if (sqlca.sqlcode != 0)
+		return 0;
+	sqli_curs_free(ESQLINTVERSION, stmt);
+	return 1;
+}
+
+
+/*
+** Undo the session state a user of a pooled connection left behind:
+** transaction, fetch options, trace, query hook, slow threshold and
+** timeout. The cursors and statements of that user stop working, see
+** checkgeneration. Returns 0 if the connection should not be reused.
+*/
+static int conn_reset (lua_State *L, conn_data *conn) {
+	if (conn->auto_commit == 0) {
+		set_conn(L, conn);
+		sqli_trans_rollback();
+		memcpy(&(conn->conn_sqlca), &sqlca, sizeof(ifx_sqlca_t));
+		if (sqlca.sqlcode != 0)
+			return 0;
+	}
+	result_txn_end(L, conn);
+	conn->auto_commit = 1;
+	conn->auto_begin = 0;
+	default_opts(&(conn->opts));
+	trace_close(conn);
+	luaL_unref(L, LUA_REGISTRYINDEX, conn->hook);
+	conn->hook = LUA_NOREF;
+	conn->slow = SLOW_THRESHOLD;
+	conn->timeout = 0;
+	conn->deadline = 0;
+	conn->cancel = 0;
+	conn->broken = NULL;
+	conn->generation++;
+	return 1;
+}
+
+
+/*
+** Close the idle connections released idle_timeout seconds ago or more,
+** keeping at least min connections open. Returns how many were closed.
+*/
+static int pool_reap (lua_State *L, pool_data *pool, double now) {
+	conn_data *conn;
+	int i, n = 0;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pool->idle);
+	for (i = 1; i <= pool->nidle; i++) {
+		lua_rawgeti(L, -1, i);
+		conn = (conn_data *)lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		if (!conn->closed) {
+			if ((pool->idle_timeout <= 0) || (now - conn->idle_since < pool->idle_timeout)
+			  || (pool->busy + pool->nidle - n <= pool->min))
+				break;
+			conn_nullify(L, conn);
+		}
+		n++;
+	}
+	if (n > 0) {
+		for (i = n + 1; i <= pool->nidle; i++) {
+			lua_rawgeti(L, -1, i);
+			lua_rawseti(L, -2, i - n);
+		}
+		for (i = pool->nidle - n + 1; i <= pool->nidle; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, -2, i);
+		}
+		pool->nidle -= n;
+	}
+	lua_pop(L, 1);
+	return n;
+}
+
+
+/*
+** Check a connection out of the pool: the most recently released one
+** that answers a ping, or a new one while the pool has room.
+** When the pool is exhausted and timeout is given, run the garbage
+** collector once, as only connections dropped without release and
+** collected can give a slot back, and try again. Waiting longer cannot
+** help, nothing else releases a connection while the Lua state waits.
+*/
+static int pool_acquire (lua_State *L) {
+	pool_data *pool = getpool(L);
+	double timeout = luaL_optnumber(L, 2, 0);
+	double start = now_seconds(), waited;
+	conn_data *conn;
+	int r, waiting = 0;
+
+	pool->acquires++;
+	pool_reap(L, pool, start);
+	for (;;) {
+		while (pool->nidle > 0) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, pool->idle);
+			lua_rawgeti(L, -1, pool->nidle);
+			lua_pushnil(L);
+			lua_rawseti(L, -3, pool->nidle);
+			lua_remove(L, -2);
+			pool->nidle--;
+			conn = (conn_data *)lua_touserdata(L, -1);
+			if (conn->closed) {
+				lua_pop(L, 1);
+				continue;
+			}
+			conn->pool_idle = 0;
+			pool->busy++;
+			if (conn_ping(L, conn))
+				goto done;
+			pool->failed_checks++;
+			conn_nullify(L, conn);
+			lua_pop(L, 1);
+		}
+		if (pool->busy < pool->max) {
+			r = pool_open(L, pool);
+			if (r != 1)
+				return r;
+			goto done;
+		}
+		if ((timeout <= 0) || waiting++)
+			break;
+		pool->waits++;
+		lua_gc(L, LUA_GCCOLLECT, 0);
+	}
+	pool->timeouts++;
+	lua_pushnil(L);
+	lua_pushfstring(L, LUASQL_PREFIX"connection pool exhausted (%d connections)", pool->max);
+	return 2;
+
+done:
+	waited = now_seconds() - start;
+	pool->wait_time += waited;
+	if (waited > pool->max_wait)
+		pool->max_wait = waited;
+	return 1;
+}
+
+
+/*
+** Check a connection back in. An open transaction is rolled back and the
+** session settings are reset (see conn_reset); a connection that fails
+** this is closed.
+*/
+static int pool_release (lua_State *L) {
+	pool_data *pool = (pool_data *)luaL_checkudata(L, 1, LUASQL_POOL_INFORMIX);
+	conn_data *conn = (conn_data *)luaL_checkudata(L, 2, LUASQL_CONNECTION_INFORMIX);
+	int owned;
+
+	luaL_argcheck(L, pool != NULL, 1, "pool expected");
+	if (conn->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, conn->pool);
+	owned = (conn->pool != LUA_NOREF) && lua_rawequal(L, -1, 1);
+	lua_pop(L, 1);
+	luaL_argcheck(L, owned, 2, "connection of this pool expected");
+	luaL_argcheck(L, !conn->pool_idle, 2, "connection already released");
+	luaL_argcheck(L, conn->async == NULL, 2, "connection is busy with an asynchronous call");
+	if (pool->closed || !conn_reset(L, conn)) {
+		conn_nullify(L, conn);
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+	conn->pool_idle = 1;
+	conn->idle_since = now_seconds();
+	pool->busy--;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pool->idle);
+	lua_pushvalue(L, 2);
+	lua_rawseti(L, -2, ++pool->nidle);
+	lua_pop(L, 1);
+	pool_reap(L, pool, conn->idle_since);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Close expired idle connections, return how many were closed.
+*/
+static int pool_reapidle (lua_State *L) {
+	pool_data *pool = getpool(L);
+	lua_pushinteger(L, pool_reap(L, pool, now_seconds()));
+	return 1;
+}
+
+
+static void setnumfield (lua_State *L, const char *name, lua_Number value) {
+	lua_pushstring(L, name);
+	lua_pushnumber(L, value);
+	lua_rawset(L, -3);
+}
+
+
+/*
+** Size, wait time and churn of the pool.
+*/
+static int pool_stats (lua_State *L) {
+	pool_data *pool = (pool_data *)luaL_checkudata(L, 1, LUASQL_POOL_INFORMIX);
+	luaL_argcheck(L, pool != NULL, 1, "pool expected");
+
+	lua_newtable(L);
+	setnumfield(L, "size", pool->busy + pool->nidle);
+	setnumfield(L, "busy", pool->busy);
+	setnumfield(L, "idle", pool->nidle);
+	setnumfield(L, "min", pool->min);
+	setnumfield(L, "max", pool->max);
+	setnumfield(L, "acquires", pool->acquires);
+	setnumfield(L, "waits", pool->waits);
+	setnumfield(L, "timeouts", pool->timeouts);
+	setnumfield(L, "wait_time", pool->wait_time);
+	setnumfield(L, "max_wait", pool->max_wait);
+	setnumfield(L, "opened", pool->opened);
+	setnumfield(L, "closed", pool->closed_cnt);
+	setnumfield(L, "failed_checks", pool->failed_checks);
+	return 1;
+}
+
+
+/*
+** Close the idle connections of the pool. Connections still checked
+** out are closed when released.
+*/
+static int pool_gc (lua_State *L) {
+	pool_data *pool = (pool_data *)luaL_checkudata(L, 1, LUASQL_POOL_INFORMIX);
+	conn_data *conn;
+	int i;
+
+	if (pool != NULL && !(pool->closed)) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, pool->idle);
+		for (i = 1; i <= pool->nidle; i++) {
+			lua_rawgeti(L, -1, i);
+			conn = (conn_data *)lua_touserdata(L, -1);
+			if (!conn->closed)
+				conn_nullify(L, conn);
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+		pool->nidle = 0;
+		pool->closed = 1;
+		luaL_unref(L, LUA_REGISTRYINDEX, pool->idle);
+		luaL_unref(L, LUA_REGISTRYINDEX, pool->login);
+		luaL_unref(L, LUA_REGISTRYINDEX, pool->env);
+	}
+	return 0;
+}
+
+
+/*
+** Close a pool object. Idle connections hold their pool, so a pool
+** with idle connections lives until it is closed.
+*/
+static int pool_close (lua_State *L) {
+	pool_data *pool = (pool_data *)luaL_checkudata(L, 1, LUASQL_POOL_INFORMIX);
+	luaL_argcheck(L, pool != NULL, 1, LUASQL_PREFIX"pool expected");
+	if (pool->closed) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	pool_gc(L);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Create a connection pool of the environment and open its first min
+** connections.
+** env:pool{db=, user=, password=, min=, max=, idle_timeout=}
+*/
+static int env_pool (lua_State *L) {
+	pool_data *pool;
+	const char *db;
+	conn_data *conn;
+	int i;
+
+	getenvironment(L);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	lua_settop(L, 2);
+	pool = (pool_data *)lua_newuserdata(L, sizeof(pool_data));
+	luasql_setmeta(L, LUASQL_POOL_INFORMIX);
+	memset(pool, 0, sizeof(pool_data));
+	pool->closed = 1;			/* until fully built */
+	pool->min = getoptint(L, 2, "min", 0);
+	pool->max = getoptint(L, 2, "max", POOL_MAX_SIZE);
+	luaL_argcheck(L, pool->min >= 0 && pool->max >= 1 && pool->min <= pool->max, 2, "invalid pool size");
+	lua_getfield(L, 2, "idle_timeout");
+	pool->idle_timeout = luaL_optnumber(L, -1, POOL_IDLE_TIMEOUT);
+	lua_pop(L, 1);
+
+	lua_createtable(L, 3, 0);
+	lua_getfield(L, 2, "db");
+	db = lua_tostring(L, -1);
+	luaL_argcheck(L, db != NULL, 2, "db expected");
+	lua_rawseti(L, -2, 1);
+	lua_getfield(L, 2, "user");
+	lua_rawseti(L, -2, 2);
+	lua_getfield(L, 2, "password");
+	lua_rawseti(L, -2, 3);
+	pool->login = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_newtable(L);
+	pool->idle = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_pushvalue(L, 1);
+	pool->env = luaL_ref(L, LUA_REGISTRYINDEX);
+	pool->closed = 0;
+
+	/* pool at index 1 for pool_open and pool_release */
+	lua_replace(L, 1);
+	lua_settop(L, 1);
+	for (i = 0; i < pool->min; i++) {
+		if (pool_open(L, pool) != 1) {
+			pool_gc(L);
+			return 2;
+		}
+		conn = (conn_data *)lua_touserdata(L, -1);
+		conn_reset(L, conn);
+		conn->pool_idle = 1;
+		conn->idle_since = now_seconds();
+		pool->busy--;
+		lua_rawgeti(L, LUA_REGISTRYINDEX, pool->idle);
+		lua_insert(L, -2);
+		lua_rawseti(L, -2, ++pool->nidle);
+		lua_pop(L, 1);
+	}
+	return 1;
+}
+
+
+/*
+** Counters of all connections of the environment, open and closed,
+** and of its result cache as
+** result_cache = {hits=, misses=, hit_rate=, stores=, entries=, bytes=,
+**  max_bytes=, evictions=, expirations=, invalidations=, bypasses=}.
+*/
+static int env_stats (lua_State *L) {
+	env_data *env = getenvironment(L);
+	result_cache *cache = &(env->cache);
+	conn_stats total;
+	conn_data *conn;
+
+	total = env->closed_stats;
+	LOCK_CONN_LIST();
+	for (conn = conn_list; conn != NULL; conn = conn->list_next) {
+		if (conn->envp == env)
+			stats_add(&total, &(conn->stats));
+	}
+	UNLOCK_CONN_LIST();
+	pushstats(L, &total);
+	lua_pushstring(L, "result_cache");
+	lua_createtable(L, 0, 11);
+	setnumfield(L, "hits", cache->hits);
+	setnumfield(L, "misses", cache->misses);
+	setnumfield(L, "hit_rate", (cache->hits + cache->misses > 0) ?
+		(lua_Number)cache->hits / (cache->hits + cache->misses) : 0);
+	setnumfield(L, "stores", cache->stores);
+	setnumfield(L, "entries", cache->count);
+	setnumfield(L, "bytes", cache->bytes);
+	setnumfield(L, "max_bytes", cache->max_bytes);
+	setnumfield(L, "evictions", cache->evictions);
+	setnumfield(L, "expirations", cache->expirations);
+	setnumfield(L, "invalidations", cache->invalidations);
+	setnumfield(L, "bypasses", cache->bypasses);
+	lua_rawset(L, -3);
+	return 1;
+}
+
+
+/*
+** Drop the entries of the result cache and free it. Results being
+** filled by cursors are not kept.
+*/
+static void result_cache_free (result_cache *cache) {
+	result_entry *e;
+
+	result_cache_drop(cache, NULL);
+	while ((e = cache->capturing) != NULL) {
+		cache->capturing = e->next;
+		e->prev = e->next = NULL;
+		e->cache = NULL;
+	}
+	free(cache->buckets);
+	cache->buckets = NULL;
+	cache->max_bytes = 0;
+}
+
+
+/*
+** Set up the result cache of the environment. The results of SELECTs
+** run by conn:execute and prepared statements of its connections are
+** cached, up to max_bytes in all and max_entry per result (a quarter
+** of max_bytes by default), for ttl seconds. A write by one of its
+** connections to a table drops the results reading it. max_bytes 0
+** disables the cache.
+** env:setcache{max_bytes=, max_entry=, ttl=}
+*/
+static int env_setcache (lua_State *L) {
+	env_data *env = getenvironment(L);
+	result_cache *cache = &(env->cache);
+	int max_bytes, max_entry;
+	double ttl;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+	max_bytes = getoptint(L, 2, "max_bytes", (int)cache->max_bytes);
+	max_entry = getoptint(L, 2, "max_entry", max_bytes / 4);
+	lua_getfield(L, 2, "ttl");
+	ttl = luaL_optnumber(L, -1, cache->ttl);
+	lua_pop(L, 1);
+	luaL_argcheck(L, (max_bytes >= 0) && (max_entry >= 0) && (ttl >= 0), 2, "cache limits must be non-negative");
+	if (max_bytes == 0) {
+		result_cache_free(cache);
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+	if (cache->buckets == NULL) {
+		cache->buckets = (result_entry **)calloc(RESULT_BUCKETS, sizeof(result_entry *));
+		if (cache->buckets == NULL)
+			return luasql_faildirect(L, "alloc memory fail");
+	}
+	cache->max_bytes = max_bytes;
+	cache->max_entry = (max_entry < max_bytes) ? max_entry : max_bytes;
+	cache->ttl = ttl;
+	result_cache_trim(cache);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Drop the cached results, all of them or those reading a table, as
+** after a change made outside the environment.
+** env:flushcache([table])
+*/
+static int env_flushcache (lua_State *L) {
+	env_data *env = getenvironment(L);
+	size_t len;
+	const char *table = luaL_optlstring(L, 2, NULL, &len);
+	char name[MAX_NAME_LENGTH];
+
+	if (table == NULL)
+		result_cache_drop(&(env->cache), NULL);
+	else if (sql_token(&table, table + len, name, sizeof(name)) == TOK_NAME)
+		result_cache_drop(&(env->cache), name);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+
+/*
+** Slow statements of the connections of the environment still in the
+** slow log, oldest first, as
+** {sql=, fingerprint=, elapsed=, rows=, sqlcode=, conn=, time=}.
+*/
+static int env_slowlog (lua_State *L) {
+	env_data *env = getenvironment(L);
+	unsigned long next = slowlog_next, t, seq;
+	slow_entry e;
+	int n = 0;
+
+	lua_newtable(L);
+	for (t = (next > SLOWLOG_SIZE) ? next - SLOWLOG_SIZE : 0; t < next; t++) {
+		slow_entry *p = &(slowlog[t & (SLOWLOG_SIZE - 1)]);
+		seq = p->seq;
+		if (seq != t + 1)
+			continue;			/* being written or overwritten */
+		__sync_synchronize();
+		memcpy(&e, p, sizeof(slow_entry));
+		__sync_synchronize();
+		if ((p->seq != seq) || (e.env != env))
+			continue;
+		lua_createtable(L, 0, 7);
+		lua_pushstring(L, "sql");
+		lua_pushstring(L, e.sql);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "fingerprint");
+		pushfingerprint(L, e.sql, strlen(e.sql));
+		lua_rawset(L, -3);
+		lua_pushstring(L, "elapsed");
+		lua_pushnumber(L, e.elapsed);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "rows");
+		lua_pushinteger(L, e.rows);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "sqlcode");
+		lua_pushinteger(L, e.sqlcode);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "conn");
+		lua_pushstring(L, e.conn);
+		lua_rawset(L, -3);
+		lua_pushstring(L, "time");
+		lua_pushnumber(L, e.when);
+		lua_rawset(L, -3);
+		lua_rawseti(L, -2, ++n);
 	}
-	return create_connection(L, 1, connid);
+	return 1;
 }
 
 
@@ -1093,6 +7241,7 @@ inline static void env_disconnect (env_data *env)
 {
 	/* disconnect all connection */
 	sqli_connect_close(2, (char *)0, 0, 0);
+	active_conn = NULL;
 }
 
 
@@ -1103,6 +7252,7 @@ static int env_gc (lua_State *L) {
 	env_data *env= (env_data *)luaL_checkudata(L, 1, LUASQL_ENVIRONMENT_INFORMIX);
 	if (env != NULL && !(env->closed)) {
 		env_disconnect(env);
+		result_cache_free(&(env->cache));
 		env->closed = 1;
 	}
 	return 0;
@@ -1122,6 +7272,7 @@ static int env_close (lua_State *L) {
 
 	/* close connections */
 	env_disconnect(env);
+	result_cache_free(&(env->cache));
 	env->closed = 1;
 	lua_pushboolean(L, 1);
 	return 1;
@@ -1136,18 +7287,62 @@ static void create_metatables (lua_State *L) {
 		{"__gc", env_gc},
 		{"close", env_close},
 		{"connect", env_connect},
+		{"pool", env_pool},
+		{"stats", env_stats},
+		{"setcache", env_setcache},
+		{"flushcache", env_flushcache},
+		{"slowlog", env_slowlog},
+		{NULL, NULL},
+	};
+	struct luaL_Reg async_methods[] = {
+		{"__gc", async_gc},
+		{"poll", async_poll},
+		{"wait", async_wait},
+		{"fd", async_fd},
+		{"result", async_result},
+		{"await", async_await},
+		{NULL, NULL},
+	};
+	struct luaL_Reg replay_methods[] = {
+		{"__gc", replay_gc},
+		{"close", replay_close},
+		{"next", replay_next},
+		{NULL, NULL},
+	};
+	struct luaL_Reg pool_methods[] = {
+		{"__gc", pool_gc},
+		{"close", pool_close},
+		{"acquire", pool_acquire},
+		{"release", pool_release},
+		{"reap", pool_reapidle},
+		{"stats", pool_stats},
 		{NULL, NULL},
 	};
 	struct luaL_Reg connection_methods[] = {
 		{"__gc", conn_gc},
 		{"close", conn_close},
+		{"detach", conn_detach},
+		{"settimeout", conn_settimeout},
+		{"cancel", conn_cancel},
+		{"getid", conn_getid},
 		{"execute", conn_execute},
+		{"execute_async", conn_execute_async},
+		{"prepare", conn_prepare},
+		{"load", conn_load},
 		{"transbegin", conn_transbegin},
 		{"commit", conn_commit},
 		{"rollback", conn_rollback},
 		{"setautocommit", conn_setautocommit},
 		{"getlastserial", conn_getlastserialvalue},
 		{"getresult", conn_getresult},
+		{"flushcache", conn_flushcache},
+		{"setcachesize", conn_setcachesize},
+		{"getcachestats", conn_getcachestats},
+		{"stats", conn_stats_fn},
+		{"sethook", conn_sethook},
+		{"settrace", conn_settrace},
+		{"replay", conn_replay},
+		{"setoption", conn_setoption},
 		{"escape", escape_string},
 		{"datetoint", datetoint},
 		{"inttodate", inttodate},
@@ -1160,13 +7355,45 @@ static void create_metatables (lua_State *L) {
 		{"getcoltypes", cur_getcoltypes},
 		{"getfldnum", cur_getfieldnum},
 		{"fetch", cur_fetch},
+		{"fetchmany", cur_fetchmany},
+		{"fetchall", cur_fetchall},
+		{"fetchcolumns", cur_fetchcolumns},
+		{"fetch_absolute", cur_fetch_absolute},
+		{"fetch_relative", cur_fetch_relative},
+		{"first", cur_first},
+		{"last", cur_last},
+		{"skip", cur_skip},
+		{"setoption", cur_setoption},
 		{"iterator", cur_getiter},
 		{NULL, NULL},
 	};
+	struct luaL_Reg lob_methods[] = {
+		{"__gc", lob_gc},
+		{"close", lob_close},
+		{"read", lob_read},
+		{"chunks", lob_chunks},
+		{"writeto", lob_writeto},
+		{"size", lob_size},
+		{NULL, NULL},
+	};
+	struct luaL_Reg statement_methods[] = {
+		{"__gc", stmt_gc},
+		{"close", stmt_close},
+		{"execute", stmt_execute},
+		{"query", stmt_query},
+		{"executemany", stmt_executemany},
+		{"getparamnum", stmt_getparamnum},
+		{NULL, NULL},
+	};
 	luasql_createmeta(L, LUASQL_ENVIRONMENT_INFORMIX, environment_methods);
 	luasql_createmeta(L, LUASQL_CONNECTION_INFORMIX, connection_methods);
 	luasql_createmeta(L, LUASQL_CURSOR_INFORMIX, cursor_methods);
-	lua_pop(L, 3);
+	luasql_createmeta(L, LUASQL_STATEMENT_INFORMIX, statement_methods);
+	luasql_createmeta(L, LUASQL_LOB_INFORMIX, lob_methods);
+	luasql_createmeta(L, LUASQL_POOL_INFORMIX, pool_methods);
+	luasql_createmeta(L, LUASQL_ASYNC_INFORMIX, async_methods);
+	luasql_createmeta(L, LUASQL_REPLAY_INFORMIX, replay_methods);
+	lua_pop(L, 8);
 }
 
 
@@ -1180,19 +7407,16 @@ static int create_environment (lua_State *L) {
 
 	/* fill in structure */
 	memset(env, 0, sizeof(env_data));
-	env->old_env = getenv(ENV_INFORMIX_SVR);
-	if ((env->old_env == NULL)&&(env_server == NULL)) {
+	if ((getenv(ENV_INFORMIX_SVR) == NULL)&&(env_server == NULL)) {
 		return luasql_faildirect(L, "can't found informix server environment.");
 	}
-	if (env->old_env != NULL) {
-		env->old_env -= strlen(ENV_INFORMIX_SVR)+1;   /* poing to environment string in u area */
-	}
 	if (env_server != NULL) {
-		snprintf(env->curr_env, sizeof(env->curr_env), "%s=%s", ENV_INFORMIX_SVR, env_server);
+		strncpy(env->server, env_server, sizeof(env->server)-1);
 	}
 
 	env->closed = 0;
 	env->conn_cnt = 0;
+	env->cache.ttl = RESULT_TTL;
 	return 1;
 }
 
@@ -1204,8 +7428,16 @@ static int create_environment (lua_State *L) {
 LUASQL_API int luaopen_luasql_informix (lua_State *L) { 
 	struct luaL_Reg driver[] = {
 		{"informix", create_environment},
+		{"cancel", driver_cancel},
 		{NULL, NULL},
 	};
+#ifdef RTRIM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		rtrim = rtrim_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		rtrim = rtrim_sse2;
+#endif
 	create_metatables(L);
 	lua_newtable(L);
 	luaL_setfuncs(L, driver, 0);
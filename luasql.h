@@ -32,6 +32,7 @@ LUASQL_API void luasql_set_info (lua_State *L);
 
 #if !defined LUA_VERSION_NUM || LUA_VERSION_NUM==501
 void luaL_setfuncs (lua_State *L, const luaL_Reg *l, int nup);
+#define lua_rawlen lua_objlen
 #endif
 
 #endif